@@ -1,261 +1,197 @@
 #include "ai.hpp"
 
-#include <cfloat>
 #include <climits>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <algorithm>
 #include <deque>
 #include <map>
+#include <memory>
+#include <thread>
 #include <vector>
-#include "device.hpp"
+#include "ai_state.hpp"
+#include "ai_worker.hpp"
 #include "game.hpp"
+#include "overlay_grid.hpp"
 
 using namespace std;
 
-int g_ai_update = 10; // in frames
+int g_ai_update = 10; // in simulation ticks
+int g_dijkstra_speed = 2;
 
-const int LOW_AI = 5;
-const int LOW_AI_OBSTACLE = 5;
+int HIGH_AI_TOTAL_ITERATIONS = 10000;
 
-const int MED_AI = 10;
-const int MED_AI_OBSTACLE = 10;
-const int MED_AI_NUM_BEES = 5;
-const int MED_AI_TOTAL_BEE_MOVES = 5;
+int g_ai_threads = 0;
+int g_ai_trainers = HIGH_AI_TRAINERS;
 
-const int HIGH_AI = 100;
-int HIGH_AI_TOTAL_ITERATIONS = 10000;
+ai_store::ai_store() : frame(0), shared(), worker(new ai_worker), tickets(0),
+                       _next(NO_AI + 1) {
+}
 
-// common
-map<size_t, vector<vector<int> > > g_flag_maps;
+// defined here, where ai_worker is complete
+ai_store::~ai_store() {
+}
 
-// low intelligence AI
-typedef struct {
-  int x;
-  int y;
-} pos_t;
-map<size_t, deque<pos_t> > g_ch_map_stack;
+ai_handle ai_store::create() {
+  if (_free.empty()) {
+    return _next++;
+  }
+  ai_handle ai = _free.back();
+  _free.pop_back();
+  return ai;
+}
 
-// medium intelligence AI
-const int BEE_ENEMY_IDX = 2;
-typedef struct {
-  int x;
-  int y;
-  int last;
-} bee_t;
-map<size_t, vector<bee_t> > g_bees_map;
-
-// high intelligence AI
-//  +---+---+---+   +---+---+---+
-//  |ul | u |ur |   | 0 | 1 | 2 |
-//  +---+---+---+   +---+---+---+
-//  | l | X | r |   | 3 | X | 5 |
-//  +---+---+---+   +---+---+---+
-//  |dl | d |dr |   | 6 | 7 | 8 |
-//  +---+---+---+   +---+---+---+
-typedef struct {
-  bool visited;
-  int ul;
-  int u;
-  int ur;
-  int l;
-  int r;
-  int dl;
-  int d;
-  int dr;
-} node_t;
-typedef struct {
-  int x;
-  int y;
-  int min;
-  int max;
-  int median;
-  deque<short> path;
-} graph_data_t;
-map<size_t, vector<vector<node_t> > > g_graphs;
-map<size_t, graph_data_t> g_graph_datas;
-int g_iterations = 0;
+void ai_store::destroy(ai_handle ai) {
+  flags.remove(ai);
+  low.remove(ai);
+  med.remove(ai);
+  high.remove(ai);
+  _free.push_back(ai);
+}
 
+shared_maps_t& shared_maps(Game& g) {
+  shared_maps_t& s = g.ai->shared;
+  int w = g.map.width();
+  int h = g.map.height();
+  if (s.topology && w == s.w && h == s.h && g.map_version == s.map_version) {
+    return s;
+  }
+  s.w = w;
+  s.h = h;
+  s.map_version = g.map_version;
+  s.topology = make_shared<graph_topology>(w, h, [&g](int x, int y) {
+    return g.is_walkable(x, y);
+  });
+  shared_ptr<chunked_grid<int> > no_flags = make_shared<chunked_grid<int> >();
+  no_flags->assign(w, h);
+  s.no_flags = no_flags;
+  s.attracted_flags.clear();
+  return s;
+}
 
-extern int g_dijkstra_speed;
 
-size_t nearest_character(Game& g) {
-  size_t nearest = 0;
-  double min_dist = DBL_MAX;
-  const character& ch1 = g.characters[g.turns[0]];
+character_handle nearest_character(Game& g) {
+  character_handle nearest = g.turns.current();
+  int64_t min_dist = INT64_MAX;
+  const character& ch1 = g.characters[g.turns.current()];
   for (size_t i = 0; i < g.characters.size(); ++i) {
+    character_handle other = g.characters.handle_at(i);
     // ignore self
-    if (g.turns[0] == i) {
+    if (g.turns.current() == other) {
       continue;
     }
-    const character& ch2 = g.characters[i];
+    const character& ch2 = g.characters[other];
     // no friendly fire
     if (ch1.is_playable == ch2.is_playable) {
       continue;
     }
 
-    double dist_x = abs(double(ch1.pos.x) - ch2.pos.x);
-    double dist_y = abs(double(ch1.pos.y) - ch2.pos.y);
-    double dist = pow(dist_x * dist_x + dist_y * dist_y, 0.5);
+    int dx = ch2.pos.x - ch1.pos.x;
+    int dy = ch2.pos.y - ch1.pos.y;
+    // squared, the order is the same
+    int64_t dist = int64_t(dx) * dx + int64_t(dy) * dy;
     if (dist < min_dist) {
-      nearest = i;
+      nearest = other;
       min_dist = dist;
     }
   }
   return nearest;
 }
 
-void create_character_ai(Game& g, size_t idx) {
-  const character& ch = g.characters[idx];
+void create_character_ai(Game& g, character_handle handle) {
+  character& ch = g.characters[handle];
+  ai_store& store = *g.ai;
+  shared_maps_t& shared = shared_maps(g);
+  ch.ai = store.create();
+
   // common
-  vector<vector<int> > temp(g.map.size());
-  auto& flags_map = g_flag_maps.insert(make_pair(idx, temp)).first->second;
-  for (size_t i = 0; i < flags_map.size(); ++i) {
-    flags_map[i].resize(g.map[0].size());
-  }
+  auto& flags_map = store.flags.add(ch.ai, overlay_grid<int>(shared.no_flags));
 
   // AI dependant
   if (ch.stats.intelligence <= LOW_AI) {
-    g_ch_map_stack.insert(make_pair(idx, deque<pos_t>()));
+    low_ai_t low;
+    low.is_forgetting = false;
+    store.low.add(ch.ai, low);
     puts("Created low intelligence AI");
   } else if (ch.stats.intelligence <= MED_AI) {
-    const character& ch1 = g.characters[0];
+    const character& ch1 = g.characters.dense(0);
     int x0 = ch1.pos.x;
     int y0 = ch1.pos.y;
 
-    float mult = float(MED_AI_OBSTACLE) / max(g.map.size(), g.map[0].size());
-    for (size_t i = 0; i < flags_map.size(); ++i) {
-      for (size_t j = 0; j < flags_map[i].size(); ++j) {
-        int dx = abs(int(j) - x0) * mult;
-        int dy = abs(int(i) - y0) * mult;
-        int dist = pow(float(dx * dx + dy * dy), 0.5f);
-        flags_map[i][j] = MED_AI_OBSTACLE - min(dist, MED_AI_OBSTACLE);
+    auto& base = shared.attracted_flags[size_t(y0) * shared.w + x0];
+    if (!base) {
+      shared_ptr<chunked_grid<int> > attracted =
+          make_shared<chunked_grid<int> >();
+      attracted->assign(shared.w, shared.h);
+      float mult = float(MED_AI_OBSTACLE) / max(shared.w, shared.h);
+      for (int y = 0; y < attracted->height(); ++y) {
+        for (int x = 0; x < attracted->width(); ++x) {
+          int dx = abs(x - x0) * mult;
+          int dy = abs(y - y0) * mult;
+          int dist = pow(float(dx * dx + dy * dy), 0.5f);
+          if (dist < MED_AI_OBSTACLE) {
+            attracted->edit(x, y) = MED_AI_OBSTACLE - dist;
+          }
+        }
       }
+      base = attracted;
     }
-
-    vector<bee_t> bees(MED_AI_NUM_BEES);
-    for (size_t i = 0; i < bees.size(); ++i) {
-      bees[i].x = ch.pos.x;
-      bees[i].y = ch.pos.y;
-      bees[i].last = 0;
+    flags_map = overlay_grid<int>(base);
+
+    med_ai_t med;
+    med.bees.resize(MED_AI_NUM_BEES);
+    for (size_t i = 0; i < med.bees.size(); ++i) {
+      med.bees[i].x = ch.pos.x;
+      med.bees[i].y = ch.pos.y;
+      med.bees[i].last = 0;
     }
-    g_bees_map.insert(make_pair(idx, bees));
+    med.moves = 0;
+    store.med.add(ch.ai, med);
     puts("Created medium intelligence AI");
   } else if (ch.stats.intelligence <= HIGH_AI) {
-    vector<vector<node_t> > graph(g.map.size());
-    for (size_t y = 0; y < graph.size(); ++y) {
-      graph[y].resize(g.map[0].size());
-      for (size_t x = 0; x < graph[y].size(); ++x) {
-        // map range
-        if (x >= g.map[0].size()-1) {
-          graph[y][x].ur = -1;
-          graph[y][x].r  = -1;
-          graph[y][x].dr = -1;
-        } else if (x <= 0) {
-          graph[y][x].ul = -1;
-          graph[y][x].l  = -1;
-          graph[y][x].dl = -1;
-        }
-        if (y >= g.map.size()-1) {
-          graph[y][x].dl = -1;
-          graph[y][x].d  = -1;
-          graph[y][x].dr = -1;
-        } else if (y <= 0) {
-          graph[y][x].ul = -1;
-          graph[y][x].u  = -1;
-          graph[y][x].ur = -1;
-        }
-
-        // obstacles
-        if (!g.materials[g.map[y][x]].is_walkable) {
-          graph[y][x].ul = -1;
-          graph[y][x].u  = -1;
-          graph[y][x].ur = -1;
-          graph[y][x].l  = -1;
-          graph[y][x].r  = -1;
-          graph[y][x].dl = -1;
-          graph[y][x].d  = -1;
-          graph[y][x].dr = -1;
-          continue;
-        }
-
-        const int init = INT_MAX / 2;
-        if (graph[y][x].ul != -1) {
-          graph[y][x].ul = g.materials[g.map[y-1][x-1]].is_walkable ? init : -1;
-        }
-        if (graph[y][x].u  != -1) {
-          graph[y][x].u = g.materials[g.map[y-1][x]].is_walkable ? init : -1;
-        }
-        if (graph[y][x].ur != -1) {
-          graph[y][x].ur = g.materials[g.map[y-1][x+1]].is_walkable ? init : -1;
-        }
-        if (graph[y][x].l != -1) {
-          graph[y][x].l = g.materials[g.map[y][x-1]].is_walkable ? init : -1;
-        }
-        if (graph[y][x].r != -1) {
-          graph[y][x].r = g.materials[g.map[y][x+1]].is_walkable ? init : -1;
-        }
-        if (graph[y][x].dl != -1) {
-          graph[y][x].dl = g.materials[g.map[y+1][x-1]].is_walkable ? init : -1;
-        }
-        if (graph[y][x].d != -1) {
-          graph[y][x].d = g.materials[g.map[y+1][x]].is_walkable ? init : -1;
-        }
-        if (graph[y][x].dr != -1) {
-          graph[y][x].dr = g.materials[g.map[y+1][x+1]].is_walkable ? init : -1;
-        }
-        graph[y][x].visited = false;
-      }
-    }
-    g_graphs.insert(make_pair(idx, graph));
-    graph_data_t data;
+    high_ai_t high;
+    high.graph = graph_t(shared.topology);
+    graph_data_t& data = high.data;
     data.x = ch.pos.x;
     data.y = ch.pos.y;
     data.min = INT_MAX;
     data.max = 0;
     data.median = INT_MAX / 2;
-    g_graph_datas.insert(make_pair(idx, data));
+    data.reached = false;
+    data.is_planned = false;
+    data.job = 0;
+    high.iterations = 0;
+    store.high.add(ch.ai, move(high));
     puts("Created high intelligence AI");
+  } else {
+    puts("Created pathfinding AI");
   }
 }
 
-void delete_character_ai(Game& g, size_t idx) {
-  const character& ch = g.characters[idx];
-  auto fm = g_flag_maps.find(idx);
-  if (fm != g_flag_maps.end()) {
-    g_flag_maps.erase(fm);
+void delete_character_ai(Game& g, character_handle handle) {
+  character& ch = g.characters[handle];
+  if (ch.ai == NO_AI) {
+    return;
   }
   if (ch.stats.intelligence <= LOW_AI) {
-    auto it = g_ch_map_stack.find(idx);
-    if (it != g_ch_map_stack.end()) {
-      g_ch_map_stack.erase(it);
-    }
     puts("Deleted low intelligence AI");
   } else if (ch.stats.intelligence <= MED_AI) {
-    auto it = g_bees_map.find(idx);
-    if (it != g_bees_map.end()) {
-      g_bees_map.erase(it);
-    }
     puts("Deleted medium intelligence AI");
   } else if (ch.stats.intelligence <= HIGH_AI) {
-    auto it = g_graphs.find(idx);
-    if (it != g_graphs.end()) {
-      g_graphs.erase(it);
-    }
-    auto it2 = g_graph_datas.find(idx);
-    if (it2 != g_graph_datas.end()) {
-      g_graph_datas.erase(it2);
-    }
     puts("Deleted high intelligence AI");
   }
+  g.ai->destroy(ch.ai);
+  ch.ai = NO_AI;
 }
 
 void bresenham_algorithm(Game& g) {
-  size_t nearest = nearest_character(g);
-  const character& ch1 = g.characters[g.turns[0]];
+  character_handle nearest = nearest_character(g);
+  const character& ch1 = g.characters[g.turns.current()];
   const character& ch2 = g.characters[nearest];
-  auto& flags_map = g_flag_maps.find(g.turns[0])->second;
-  auto& memstack = g_ch_map_stack.find(g.turns[0])->second;
+  auto& flags_map = *g.ai->flags.find(ch1.ai);
+  low_ai_t& low = *g.ai->low.find(ch1.ai);
+  auto& memstack = low.memory;
 
   int x0 = ch1.pos.x;
   int y0 = ch1.pos.y;
@@ -272,17 +208,16 @@ void bresenham_algorithm(Game& g) {
   // try to move in straight line
   bool moved = false;
   if (g.can_move(dx, dy, false)) {
-    if (rand() % LOW_AI_OBSTACLE >= flags_map[y0+dy][x0+dx]) {
+    if (g.dice.roll(LOW_AI_OBSTACLE) >= flags_map(x0+dx, y0+dy)) {
       moved = g.move(dx, dy);
     }
   }
   // forget oldest memory
-  static bool is_forgetting = false;
-  if (is_forgetting && !memstack.empty()) {
+  if (low.is_forgetting && !memstack.empty()) {
     auto pos = memstack.back();
-    --flags_map[pos.y][pos.x];
+    --flags_map.edit(pos.x, pos.y);
     memstack.pop_back();
-    is_forgetting = false;
+    low.is_forgetting = false;
   }
   if (moved) {
     return;
@@ -290,15 +225,15 @@ void bresenham_algorithm(Game& g) {
 
   // try to move randomly
   vector<int> neighbors = {0,1,2,3,5,6,7,8};
-  random_shuffle(neighbors.begin(), neighbors.end());
+  g.dice.shuffle(neighbors.begin(), neighbors.end());
   for (size_t i = 0; i < neighbors.size(); ++i) {
     dx = neighbors[i] % 3 - 1;
     dy = neighbors[i] / 3 - 1;
     if (g.can_move(dx, dy, false) &&
-        rand() % LOW_AI_OBSTACLE >= flags_map[y0+dy][x0+dx]) {
+        g.dice.roll(LOW_AI_OBSTACLE) >= flags_map(x0+dx, y0+dy)) {
       moved = g.move(dx, dy);
       if (moved) {
-        ++flags_map[y0][x0];
+        ++flags_map.edit(x0, y0);
         // stack to memory
         memstack.push_back({x0, y0});
         return;
@@ -306,25 +241,25 @@ void bresenham_algorithm(Game& g) {
     }
   }
   if (!moved) {
-    is_forgetting = true;
+    low.is_forgetting = true;
   }
 }
 
 void bees_algorithm(Game& g) {
-  const character& ch = g.characters[g.turns[0]];
-  auto& flags_map = g_flag_maps.find(g.turns[0])->second;
-  auto& bees = g_bees_map.find(g.turns[0])->second;
+  const character& ch = g.characters[g.turns.current()];
+  auto& flags_map = *g.ai->flags.find(ch.ai);
+  med_ai_t& med = *g.ai->med.find(ch.ai);
+  auto& bees = med.bees;
 
-  static int bee_moves = 0;
-  if (bee_moves < MED_AI_TOTAL_BEE_MOVES) {
+  if (med.moves < MED_AI_TOTAL_BEE_MOVES) {
     size_t best = 0;
     int best_temp = 0;
     for (size_t i = 0; i < bees.size(); ++i) {
       int x0 = bees[i].x;
       int y0 = bees[i].y;
-      if (flags_map[y0][x0] > best_temp) {
+      if (flags_map(x0, y0) > best_temp) {
         best = i;
-        best_temp = flags_map[y0][x0];
+        best_temp = flags_map(x0, y0);
       }
     }
     for (size_t i = 0; i < bees.size(); ++i) {
@@ -336,538 +271,641 @@ void bees_algorithm(Game& g) {
       int y0 = bees[i].y;
 
       vector<int> neighbors = {0,1,2,3,5,6,7,8};
-      random_shuffle(neighbors.begin(), neighbors.end());
-      for (size_t i = 0; i < neighbors.size(); ++i) {
+      g.dice.shuffle(neighbors.begin(), neighbors.end());
+      for (size_t j = 0; j < neighbors.size(); ++j) {
         // do not go back to the last cell
-        if (neighbors[i] == 8 - bees[i].last) {
+        if (neighbors[j] == 8 - bees[i].last) {
           continue;
         }
-        int dx = neighbors[i] % 3 - 1;
-        int dy = neighbors[i] / 3 - 1;
+        int dx = neighbors[j] % 3 - 1;
+        int dy = neighbors[j] / 3 - 1;
         int x1 = x0 + dx;
         int y1 = y0 + dy;
-        if (x1 >= 0 &&
-            x1 < int(g.map[0].size()) &&
-            y1 < int(g.map.size()) &&
-            y1 >= 0) {
-          if (g.materials[g.map[y1][x1]].is_walkable &&
-              !g.is_tile_occupied(x1, y1)) {
-            bees[i].x = x1;
-            bees[i].y = y1;
-            bees[i].last = neighbors[i];
-            break;
-          } else if (flags_map[y1][x1] > 0) {
-            --flags_map[y1][x1];
-          }
+        // tiles outside the map are never walkable and have no flags
+        if (g.is_walkable(x1, y1) &&
+            !g.is_tile_occupied(x1, y1)) {
+          bees[i].x = x1;
+          bees[i].y = y1;
+          bees[i].last = neighbors[j];
+          break;
+        } else if (flags_map(x1, y1) > 0) {
+          --flags_map.edit(x1, y1);
         }
       }
     }
-    ++bee_moves;
+    ++med.moves;
   } else {
     size_t best = 0;
     int best_temp = 0;
     for (size_t i = 0; i < bees.size(); ++i) {
       int x0 = bees[i].x;
       int y0 = bees[i].y;
-      if (flags_map[y0][x0] > best_temp) {
+      if (flags_map(x0, y0) > best_temp) {
         best = i;
-        best_temp = flags_map[y0][x0];
+        best_temp = flags_map(x0, y0);
       }
     }
     g.move(bees[best].x - ch.pos.x, bees[best].y - ch.pos.y);
-    bee_moves = 0;
+    med.moves = 0;
   }
 }
 
-void graph_algorithm(Game& g) {
-  bool draw_steps = g_dijkstra_speed > 1;
+// everyone on the other side
+vector<pos_t> enemy_positions(const Game& g, const character& ch) {
+  vector<pos_t> targets;
+  for (size_t i = 0; i < g.characters.size(); ++i) {
+    const character& ch2 = g.characters.dense(i);
+    if (ch.is_playable != ch2.is_playable) {
+      pos_t p = {ch2.pos.x, ch2.pos.y};
+      targets.push_back(p);
+    }
+  }
+  return targets;
+}
 
-  auto& flags_map = g_flag_maps.find(g.turns[0])->second;
-  auto& data = g_graph_datas.find(g.turns[0])->second;
-  auto& graph = g_graphs.find(g.turns[0])->second;
-  const character& ch = g.characters[g.turns[0]];
-
-  vector<size_t> list;
-  while (list.empty()) {
-    // check if it reached its destination
-    list.resize(0);
-    for (size_t i = 0; i < g.characters.size(); ++i) {
-      if (i == g.turns[0]) {
-        continue;
-      }
-      const character& ch2 = g.characters[i];
-      if (ch.is_playable == ch2.is_playable) {
-        continue;
+// tiles under every character, sorted
+vector<size_t> occupied_tiles(const Game& g) {
+  vector<size_t> tiles;
+  int w = g.map.width();
+  for (size_t i = 0; i < g.characters.size(); ++i) {
+    const character& ch = g.characters.dense(i);
+    for (int y = ch.pos.y; y < ch.pos.y + ch.base_size; ++y) {
+      for (int x = ch.pos.x; x < ch.pos.x + ch.base_size; ++x) {
+        if (g.occupancy.contains(x, y)) {
+          tiles.push_back(size_t(y) * w + x);
+        }
       }
+    }
+  }
+  sort(tiles.begin(), tiles.end());
+  tiles.erase(unique(tiles.begin(), tiles.end()), tiles.end());
+  return tiles;
+}
 
-      double dist_x = abs(double(data.x) - ch2.pos.x);
-      double dist_y = abs(double(data.y) - ch2.pos.y);
-      int dist = pow(dist_x * dist_x + dist_y * dist_y, 0.5) + 0.5;
-      if (dist <= ch.range) {
-        list.push_back(i);
-      }
+// check if the walker reached its destination
+bool walk_reached(const graph_data_t& data, const vector<pos_t>& targets,
+                  int range) {
+  for (size_t i = 0; i < targets.size(); ++i) {
+    if (in_range(targets[i].x - data.x, targets[i].y - data.y, range)) {
+      return true;
     }
-    static bool finished = false;
-    if (!list.empty() && !finished) {
-      finished = true;
-      return;
+  }
+  return false;
+}
+
+// tiles visited in the current walk of a trainer, a tile is flagged if the
+// current walk was the last one on it, so starting the next walk clears
+// them all
+class walk_flags {
+public:
+  walk_flags() : _walk(1) {}
+
+  void assign(int w, int h) {
+    _walks.assign(w, h, 0);
+    _walk = 1;
+  }
+  int operator()(int x, int y) const { return _walks(x, y) == _walk; }
+  void set(int x, int y) { _walks.edit(x, y) = _walk; }
+  void clear() {
+    if (++_walk == 0) {
+      assign(_walks.width(), _walks.height());
     }
-    if (finished) {
-      finished = false;
-      for (size_t y = 0; y < flags_map.size(); ++y) {
-        for (size_t x = 0; x < flags_map[y].size(); ++x) {
-          flags_map[y][x] = 0;
-        }
-      }
-      static bool first_time = true;
-      if (!first_time) {
-        data.x = ch.pos.x;
-        data.y = ch.pos.y;
-        int error = data.median - int(data.path.size());
-        for (size_t i = 0; i < data.path.size(); ++i) {
-          switch (data.path[i]) {
-            case 0:
-              graph[data.y][data.x].ul += error;
-              --data.x;
-              --data.y;
-              graph[data.y][data.x].dr += error;
-              break;
-            case 1:
-              graph[data.y][data.x].u += error;
-              --data.y;
-              graph[data.y][data.x].d += error;
-              break;
-            case 2:
-              graph[data.y][data.x].ur += error;
-              ++data.x;
-              --data.y;
-              graph[data.y][data.x].dl += error;
-              break;
-            case 3:
-              graph[data.y][data.x].l += error;
-              --data.x;
-              graph[data.y][data.x].r += error;
-              break;
-            case 5:
-              graph[data.y][data.x].r += error;
-              ++data.x;
-              graph[data.y][data.x].l += error;
-              break;
-            case 6:
-              graph[data.y][data.x].dl += error;
-              --data.x;
-              ++data.y;
-              graph[data.y][data.x].ur += error;
-              break;
-            case 7:
-              graph[data.y][data.x].d += error;
-              ++data.y;
-              graph[data.y][data.x].u += error;
-              break;
-            case 8:
-              graph[data.y][data.x].dr += error;
-              ++data.x;
-              ++data.y;
-              graph[data.y][data.x].ul += error;
-              break;
-            default:
-              fprintf(stderr, "Error: invalid path direction: %d\n",
-                      data.path[i]);
-          }
-        }
-        //printf("path:%zu\tmin:%d\tmax:%d\tmedian:%d\terror:%d\n",
-        //       data.path.size(), data.min, data.max, data.median, error);
+  }
+
+private:
+  chunked_grid<unsigned> _walks; // last walk on each tile
+  unsigned _walk;
+};
+
+// tiles visited in the current walk, by walk for the trainers and shared
+// for the AIs
+void set_walk_flag(walk_flags& flags_map, int x, int y) {
+  flags_map.set(x, y);
+}
+void set_walk_flag(overlay_grid<int>& flags_map, int x, int y) {
+  flags_map.edit(x, y) = 1;
+}
+void clear_walk_flags(walk_flags& flags_map) { flags_map.clear(); }
+void clear_walk_flags(overlay_grid<int>& flags_map) { flags_map.reset(); }
+
+// moves the walker to a random neighbor, tiles not visited in this walk
+// first, false if it is boxed in
+// learner_t is the graph itself or the deltas of a trainer
+template <class passable, class learner_t, class flags_t>
+bool walk_step(const passable& can_enter, flags_t& flags_map,
+               learner_t& learner, graph_data_t& data, rng& dice) {
+  vector<int> neighbors = {0,1,2,3,5,6,7,8};
+  dice.shuffle(neighbors.begin(), neighbors.end());
+  for (int pass = 0; pass < 2; ++pass) {
+    for (size_t i = 0; i < neighbors.size(); ++i) {
+      int x1 = data.x + neighbors[i] % 3 - 1;
+      int y1 = data.y + neighbors[i] / 3 - 1;
+      if (can_enter(x1, y1) && (pass == 1 || flags_map(x1, y1) == 0)) {
+        data.x = x1;
+        data.y = y1;
+        data.path.push_back(neighbors[i]);
+        set_walk_flag(flags_map, data.x, data.y);
+        learner.set_visited(data.x, data.y);
+        return true;
       }
-      first_time = false;
-      data.x = ch.pos.x;
-      data.y = ch.pos.y;
-      data.min = min(data.min, int(data.path.size()));
-      data.max = max(data.max, int(data.path.size()));
-      data.median = (data.max+data.min) / 2;
-      //printf("path:%zu\tmin:%d\tmax:%d\tmedian:%d\n",
-      //       data.path.size(), data.min, data.max, data.median);
-      data.path.resize(0);
-      ++g_iterations;
-      printf("%d of %d\n", g_iterations, HIGH_AI_TOTAL_ITERATIONS);
-      continue;
     }
+  }
+  return false;
+}
 
-    if (g_iterations < HIGH_AI_TOTAL_ITERATIONS) {
-      // randomly fill graph
-      bool moved = false;
-      vector<int> neighbors = {0,1,2,3,5,6,7,8};
-      random_shuffle(neighbors.begin(), neighbors.end());
-      for (size_t i = 0; i < neighbors.size(); ++i) {
-        int dx = neighbors[i] % 3 - 1;
-        int dy = neighbors[i] / 3 - 1;
-        int x1 = data.x + dx;
-        int y1 = data.y + dy;
-        if (x1 >= 0 &&
-            x1 < int(g.map[0].size()) &&
-            y1 < int(g.map.size()) &&
-            y1 >= 0 &&
-            g.materials[g.map[y1][x1]].is_walkable &&
-            !g.is_tile_occupied(x1, y1) &&
-            flags_map[y1][x1] == 0)
-        {
-          moved = true;
-          data.x = x1;
-          data.y = y1;
-          data.path.push_back(neighbors[i]);
-          flags_map[data.y][data.x] = 1;
-          graph[data.y][data.x].visited = true;
-          if (draw_steps) {
-            if (data.x - g.focus_x > 1) {
-              g.focus_x = data.x - 1;
-            } else if (g.focus_x - data.x > 1) {
-              g.focus_x = data.x + 1;
-            }
-            if (data.y - g.focus_y > 1) {
-              g.focus_y = data.y - 1;
-            } else if (g.focus_y - data.y > 1) {
-              g.focus_y = data.y + 1;
-            }
-            return;
-          }
-          break;
-        }
-      }
-      if (!moved) {
-        for (size_t i = 0; i < neighbors.size(); ++i) {
-          int dx = neighbors[i] % 3 - 1;
-          int dy = neighbors[i] / 3 - 1;
-          int x1 = data.x + dx;
-          int y1 = data.y + dy;
-          if (x1 >= 0 &&
-              x1 < int(g.map[0].size()) &&
-              y1 < int(g.map.size()) &&
-              y1 >= 0 &&
-              g.materials[g.map[y1][x1]].is_walkable &&
-              !g.is_tile_occupied(x1, y1))
-          {
-            /*
-            // avoid last visited
-            if (!data.path.empty() && neighbors[i] == data.path.back()) {
-              continue;
-            }
-            */
-            moved = true;
-            data.x = x1;
-            data.y = y1;
-            data.path.push_back(neighbors[i]);
-            flags_map[data.y][data.x] = 1;
-            graph[data.y][data.x].visited = true;
-            if (draw_steps) {
-              if (data.x - g.focus_x > 1) {
-                g.focus_x = data.x - 1;
-              } else if (g.focus_x - data.x > 1) {
-                g.focus_x = data.x + 1;
-              }
-              if (data.y - g.focus_y > 1) {
-                g.focus_y = data.y - 1;
-              } else if (g.focus_y - data.y > 1) {
-                g.focus_y = data.y + 1;
-              }
-              return;
-            }
-            break;
-          }
-        }
-      }
-    } else {
-      break;
-    }
-  }
-
-  // dijkstra
-  if (g_iterations >= HIGH_AI_TOTAL_ITERATIONS) {
-    static deque<pos_t> path;
-
-    static bool first_time = true;
-    if (first_time) {
-      first_time = false;
-      puts("Calculating Dijkstra's shortest path");
-
-      typedef struct {
-        bool visited;
-        int dist;
-        pos_t prev;
-      } dijkstra_t;
-
-      // init
-      vector<vector<dijkstra_t> > dijkstra(g.map.size());
-      for (size_t y = 0; y < dijkstra.size(); ++y) {
-        dijkstra[y].resize(g.map[y].size());
-        for (size_t x = 0; x < dijkstra[y].size(); ++x) {
-          dijkstra[y][x].visited = false;
-          dijkstra[y][x].dist = INT_MAX;
-          dijkstra[y][x].prev.x = -1;
-          dijkstra[y][x].prev.y = -1;
-        }
-      }
-      pos_t cur;
-      cur.x = ch.pos.x;
-      cur.y = ch.pos.y;
-      dijkstra[cur.y][cur.x].visited = true;
-      dijkstra[cur.y][cur.x].dist = 0;
-
-      const character& dest_ch = g.characters[nearest_character(g)];
-      pos_t dest;
-      dest.x = dest_ch.pos.x;
-      dest.y = dest_ch.pos.y;
-
-      // iterations
-      const int R = ch.range;
-      while (cur.x < dest.x-R || cur.x > dest.x+R ||
-             cur.y < dest.y-R || cur.y > dest.y+R)
-      {
-        node_t& n = graph[cur.y][cur.x];
-        dijkstra_t& d   = dijkstra[cur.y  ][cur.x  ];
-        dijkstra_t& dul = dijkstra[cur.y-1][cur.x-1];
-        dijkstra_t& du  = dijkstra[cur.y-1][cur.x  ];
-        dijkstra_t& dur = dijkstra[cur.y-1][cur.x+1];
-        dijkstra_t& dl  = dijkstra[cur.y  ][cur.x-1];
-        dijkstra_t& dr  = dijkstra[cur.y  ][cur.x+1];
-        dijkstra_t& ddl = dijkstra[cur.y+1][cur.x-1];
-        dijkstra_t& dd  = dijkstra[cur.y+1][cur.x  ];
-        dijkstra_t& ddr = dijkstra[cur.y+1][cur.x+1];
-
-        // measure neighbor's distances and get minimum path
-        if (n.ul != -1 && !dul.visited && d.dist+n.ul < dul.dist) {
-          dul.dist = d.dist+n.ul;
-          dul.prev = cur;
-        }
-        if (n.u != -1 && !du.visited && d.dist+n.u < du.dist) {
-          du.dist = d.dist+n.u;
-          du.prev = cur;
-        }
-        if (n.ur != -1 && !dur.visited && d.dist+n.ur < dur.dist) {
-          dur.dist = d.dist+n.ur;
-          dur.prev = cur;
-        }
-        if (n.l != -1 && !dl.visited && d.dist+n.l < dl.dist) {
-          dl.dist = d.dist+n.l;
-          dl.prev = cur;
-        }
-        if (n.r != -1 && !dr.visited && d.dist+n.r < dr.dist) {
-          dr.dist = d.dist+n.r;
-          dr.prev = cur;
-        }
-        if (n.dl != -1 && !ddl.visited && d.dist+n.dl < ddl.dist) {
-          ddl.dist = d.dist+n.dl;
-          ddl.prev = cur;
-        }
-        if (n.d != -1 && !dd.visited && d.dist+n.d < dd.dist) {
-          dd.dist = d.dist+n.d;
-          dd.prev = cur;
-        }
-        if (n.dr != -1 && !ddr.visited && d.dist+n.dr < ddr.dist) {
-          ddr.dist = d.dist+n.dr;
-          ddr.prev = cur;
-        }
+// starts a new walk from start, learning from the last one if it got there
+// the edges of walks shorter than the median get cheaper and the others
+// more expensive
+template <class learner_t, class flags_t>
+void restart_walk(learner_t& learner, graph_data_t& data,
+                  flags_t& flags_map, pos_t start, bool learn) {
+  clear_walk_flags(flags_map);
+  // the first walk only sets the median
+  if (learn && data.max > 0) {
+    data.x = start.x;
+    data.y = start.y;
+    int error = int(data.path.size()) - data.median;
+    for (size_t i = 0; i < data.path.size(); ++i) {
+      // edges are shared by both tiles, one update covers both directions
+      int dir = data.path[i];
+      learner.learn(data.x, data.y, dir, error);
+      data.x += dir % 3 - 1;
+      data.y += dir / 3 - 1;
+    }
+  }
+  if (learn) {
+    data.min = min(data.min, int(data.path.size()));
+    data.max = max(data.max, int(data.path.size()));
+    data.median = (data.max+data.min) / 2;
+  }
+  data.x = start.x;
+  data.y = start.y;
+  data.path.resize(0);
+}
 
-        // find the unvisited node with minimum distance
-        int min_dist = INT_MAX;
-        pos_t min = cur;
-        for (size_t y = 0; y < dijkstra.size(); ++y) {
-          for (size_t x = 0; x < dijkstra[y].size(); ++x) {
-            dijkstra_t& d = dijkstra[y][x];
-            if (!d.visited && d.dist < min_dist) {
-              min_dist = d.dist;
-              min.x = x;
-              min.y = y;
-            }
-          }
-        }
+// walks that never find a target are given up after this many steps
+size_t max_walk(const graph_t& graph) {
+  return size_t(HIGH_AI_MAX_WALK) * graph.width() * graph.height();
+}
 
-        // visit min
-        cur = min;
-        dijkstra[cur.y][cur.x].visited = true;
+// what a trainer learned during an epoch, stored like the edges of the
+// graph in chunks of tiles, with the edges and tiles it touched
+class graph_delta {
+public:
+  graph_delta() : _graph(NULL) {}
+
+  void assign(const graph_t& graph) {
+    _graph = &graph;
+    _edges.assign(graph.width(), graph.height());
+    _visited.assign(graph.width(), graph.height(), false);
+    _learned.clear();
+    _visits.clear();
+  }
+
+  // the edge must be between two tiles of the map
+  void learn(int x, int y, int dir, int delta) {
+    int slot = graph_topology::slot(x, y, dir);
+    int& sum = _edges.edit(x, y).slots[slot];
+    if (sum == 0) {
+      _learned.push_back(_graph->index(x, y) * 4 + slot);
+    }
+    sum += delta;
+  }
+  void set_visited(int x, int y) {
+    if (!_visited(x, y)) {
+      _visited.edit(x, y) = true;
+      _visits.push_back(_graph->index(x, y));
+    }
+  }
+
+  // adds the deltas to the graph and starts over, only the edges and tiles
+  // touched since the last time are looked at
+  void apply(graph_t& graph) {
+    for (size_t i = 0; i < _learned.size(); ++i) {
+      size_t e = _learned[i];
+      int& sum = _edges.edit(graph.x_of(e / 4), graph.y_of(e / 4))
+                     .slots[e % 4];
+      if (sum != 0) {
+        graph.learn(e, sum);
+        sum = 0;
       }
-      // backpropagate path
-      do {
-        path.push_front(cur);
-        cur = dijkstra[cur.y][cur.x].prev;
-      } while (cur.x >= 0 && cur.y >= 0);
     }
+    for (size_t i = 0; i < _visits.size(); ++i) {
+      int x = graph.x_of(_visits[i]);
+      int y = graph.y_of(_visits[i]);
+      graph.set_visited(x, y);
+      _visited.edit(x, y) = false;
+    }
+    _learned.clear();
+    _visits.clear();
+  }
+
+private:
+  typedef struct {
+    int slots[4]; // like tile_edges_t
+  } deltas_t;
+
+  const graph_t* _graph;
+  chunked_grid<deltas_t> _edges;
+  chunked_grid<bool> _visited;
+  vector<size_t> _learned; // edges, again if their delta went back to 0
+  vector<size_t> _visits; // tiles
+};
 
-    // move
-    g.move(path.front().x-ch.pos.x, path.front().y-ch.pos.y);
-    path.pop_front();
+// walks of one trainer, learned into its own deltas
+typedef struct {
+  graph_delta delta;
+  graph_data_t data;
+  walk_flags flags_map;
+  rng dice;
+  int walks; // in this epoch
+} trainer_t;
+
+// count random walks from the start of the job, learning into t.delta
+void random_walks(const high_ai_job_t& job, trainer_t& t, int count) {
+  // an edge from the walker means the tile is walkable, the topology is
+  // built and never changes
+  const graph_topology& topology = job.graph.topology();
+  const vector<size_t>& occupied = job.occupied;
+  const int w = topology.width();
+  auto can_enter = [&topology, &occupied, &t, w](int x, int y) {
+    int dir = (y - t.data.y + 1) * 3 + x - t.data.x + 1;
+    return topology.has_edge(t.data.x, t.data.y, dir) &&
+           !binary_search(occupied.begin(), occupied.end(),
+                          size_t(y) * w + x);
+  };
+  const size_t longest = max_walk(job.graph);
+  restart_walk(t.delta, t.data, t.flags_map, job.start, false);
+  for (int walks = 0; walks < count;) {
+    if (walk_reached(t.data, job.targets, job.range)) {
+      restart_walk(t.delta, t.data, t.flags_map, job.start, true);
+      ++walks;
+    } else if (!walk_step(can_enter, t.flags_map, t.delta, t.data, t.dice) ||
+               t.data.path.size() >= longest) {
+      restart_walk(t.delta, t.data, t.flags_map, job.start, false);
+      ++walks;
+    }
   }
 }
 
-void process_ai(Game& g) {
-  static int ai_frame = 0;
-  bool can_take_actions = false;
-  vector<size_t> list;
-  character& ch = g.characters[g.turns[0]];
-  if (!ch.is_playable && ai_frame++ >= g_ai_update) {
-    ai_frame = 0;
-
-    srand(clock());
-    list = g.attack_range();
-    if (list.empty()) {
-      // movement depending on intelligence
-      if (ch.stats.intelligence <= LOW_AI) {
-        bresenham_algorithm(g);
-      } else if (ch.stats.intelligence <= MED_AI) {
-        bees_algorithm(g);
-      } else if (ch.stats.intelligence <= HIGH_AI) {
-        graph_algorithm(g);
+// runs the walks of a job on every core, in epochs
+// the walks are split between the trainers of the job, each with its own
+// random generator and deltas, so the threads only change how fast they run
+// during an epoch each trainer learns into its own deltas starting from the
+// same median, at the end the deltas are added to the graph in trainer
+// order and the median updated from the walks of every trainer
+int train_high_ai(high_ai_job_t& job) {
+  graph_t& graph = job.graph;
+  graph_data_t& data = job.data;
+  int w = graph.width();
+  int h = graph.height();
+
+  const int count = job.trainers;
+  vector<trainer_t> trainers(count);
+  for (int i = 0; i < count; ++i) {
+    trainers[i].delta.assign(graph);
+    trainers[i].flags_map.assign(w, h);
+    trainers[i].dice.reseed(job.seed + i);
+  }
+  int threads = g_ai_threads;
+  if (threads <= 0) {
+    threads = max(int(thread::hardware_concurrency()), 1);
+  }
+  threads = min(threads, count);
+
+  // the first walk only sets the median the others learn from
+  int walks = 0;
+  trainers[0].data = data;
+  while (walks < job.iterations && trainers[0].data.max == 0) {
+    random_walks(job, trainers[0], 1);
+    ++walks;
+  }
+  trainers[0].delta.apply(graph);
+  data.min = trainers[0].data.min;
+  data.max = trainers[0].data.max;
+  data.median = trainers[0].data.median;
+
+  while (walks < job.iterations) {
+    int epoch = min(job.iterations - walks, count * HIGH_AI_EPOCH_WALKS);
+    for (int i = 0; i < count; ++i) {
+      trainer_t& t = trainers[i];
+      t.data = data;
+      t.walks = epoch / count + (i < epoch % count);
+    }
+    // thread k runs trainers k, k + threads...
+    vector<thread> pool;
+    for (int k = 0; k < threads; ++k) {
+      auto run = [&job, &trainers, count, threads, k]() {
+        for (int i = k; i < count; i += threads) {
+          random_walks(job, trainers[i], trainers[i].walks);
+        }
+      };
+      if (k + 1 < threads) {
+        pool.push_back(thread(run));
       } else {
-        g.end_turn();
+        run();
       }
-    } else {
-      g.attack(list[rand() % list.size()]);
-      g.end_turn();
+    }
+    for (size_t i = 0; i < pool.size(); ++i) {
+      pool[i].join();
     }
 
-    if (can_take_actions) {
-    } else if (g.move_limit == 0) {
-      g.end_turn();
+    // reduce
+    for (int i = 0; i < count; ++i) {
+      trainer_t& t = trainers[i];
+      t.delta.apply(graph);
+      data.min = min(data.min, t.data.min);
+      data.max = max(data.max, t.data.max);
     }
+    data.median = (data.max+data.min) / 2;
+    walks += epoch;
   }
+  data.x = job.start.x;
+  data.y = job.start.y;
+  data.path.resize(0);
+  return walks;
 }
 
-void draw_ai(Device& d, const Game& g) {
-  size_t idx = g.turns[0];
-  const character& ch = g.characters[idx];
-  if (ch.is_playable) {
-    return;
+void plan_high_ai(high_ai_job_t& job, high_ai_plan_t& plan) {
+  int walks = train_high_ai(job);
+  graph_t& graph = job.graph;
+  graph_data_t& data = job.data;
+
+  // dijkstra towards the nearest target
+  size_t nearest = 0;
+  for (size_t i = 1; i < job.targets.size(); ++i) {
+    int64_t dx0 = job.targets[nearest].x - job.start.x;
+    int64_t dy0 = job.targets[nearest].y - job.start.y;
+    int64_t dx1 = job.targets[i].x - job.start.x;
+    int64_t dy1 = job.targets[i].y - job.start.y;
+    if (dx1 * dx1 + dy1 * dy1 < dx0 * dx0 + dy0 * dy0) {
+      nearest = i;
+    }
   }
-  auto it = g_flag_maps.find(idx);
-  if (it == g_flag_maps.end()) {
-    fputs("Error: flags map not created", stderr);
-    return;
+  data.plan.clear();
+  if (!job.targets.empty()) {
+    dijkstra(graph, job.start, job.targets[nearest], job.range, data.plan);
   }
-  auto& flags_map = it->second;
+  data.is_planned = true;
 
-  if (ch.stats.intelligence <= LOW_AI) {
-    for (size_t y = 0; y < flags_map.size(); ++y) {
-      for (size_t x = 0; x < flags_map[0].size(); ++x) {
-        if (!g.materials[g.map[y][x]].is_walkable) {
-          continue;
-        }
-        float f = flags_map[y][x];
-        Uint8 r = Uint8(f / LOW_AI_OBSTACLE * 255.0f);
-        Uint8 b = 255 - r;
-        SDL_Color color = {r,0,b,255};
-        d.draw_rect(d.pos_x(g,x)+3, d.pos_y(g,y)+3, 57, 57, color);
-        d.draw_rect(d.pos_x(g,x)+4, d.pos_y(g,y)+4, 55, 55, color);
-        d.draw_rect(d.pos_x(g,x)+5, d.pos_y(g,y)+5, 53, 53, color);
-      }
+  plan.ticket = job.ticket;
+  plan.iterations = walks;
+  plan.graph = move(graph);
+  plan.data = move(data);
+}
+
+// hands the training and planning to the worker, true once the plan is back
+bool think_in_background(Game& g, high_ai_t& high) {
+  const character& ch = g.characters[g.turns.current()];
+  graph_data_t& data = high.data;
+  if (data.job == 0) {
+    unique_ptr<high_ai_job_t> job(new high_ai_job_t);
+    job->ticket = ++g.ai->tickets;
+    job->occupied = occupied_tiles(g);
+    job->targets = enemy_positions(g, ch);
+    job->start.x = ch.pos.x;
+    job->start.y = ch.pos.y;
+    job->range = ch.range;
+    job->iterations = max(HIGH_AI_TOTAL_ITERATIONS - high.iterations, 0);
+    job->trainers = max(g_ai_trainers, 1);
+    // one after the other, the order of the operands of | is unspecified
+    uint32_t hi = g.dice.next();
+    uint32_t lo = g.dice.next();
+    job->seed = uint64_t(hi) << 32 | lo;
+    // the worker can't read the map to build what is left of the topology
+    high.graph.topology().build();
+    job->graph = high.graph;
+    job->data = data;
+    if (g.ai->worker->submit(move(job))) {
+      data.job = g.ai->tickets;
+      puts("Thinking in the background");
     }
-  } else if (ch.stats.intelligence <= MED_AI) {
-    for (size_t y = 0; y < flags_map.size(); ++y) {
-      for (size_t x = 0; x < flags_map[0].size(); ++x) {
-        if (!g.materials[g.map[y][x]].is_walkable) {
-          continue;
-        }
-        float f = flags_map[y][x];
-        Uint8 r = Uint8(f / MED_AI_OBSTACLE * 255.0f);
-        Uint8 b = 255 - r;
-        SDL_Color color = {r,0,b,255};
-        d.draw_rect(d.pos_x(g,x)+3, d.pos_y(g,y)+3, 57, 57, color);
-        d.draw_rect(d.pos_x(g,x)+4, d.pos_y(g,y)+4, 55, 55, color);
-        d.draw_rect(d.pos_x(g,x)+5, d.pos_y(g,y)+5, 53, 53, color);
+  }
+
+  return data.is_planned;
+}
+
+// plans can come back for anyone, whatever the speed is now
+void poll_plans(Game& g) {
+  unique_ptr<high_ai_plan_t> plan;
+  while (g.ai->worker->poll(plan)) {
+    for (size_t i = 0; i < g.ai->high.size(); ++i) {
+      high_ai_t& high = g.ai->high[i];
+      if (high.data.job == plan->ticket) {
+        high.graph = move(plan->graph);
+        high.data = move(plan->data);
+        high.data.job = 0;
+        high.iterations = min(high.iterations + plan->iterations,
+                              HIGH_AI_TOTAL_ITERATIONS);
+        puts("Plan ready");
+        break;
       }
     }
-    auto it2 = g_bees_map.find(idx);
-    if (it2 != g_bees_map.end()) {
-      auto& bees = it2->second;
-      for (size_t i = 0; i < bees.size(); ++i) {
-        const auto& b = bees[i];
-        d.draw_sprite(d.pos_x(g, b.x) - g.enemies[BEE_ENEMY_IDX].base_start,
-                      d.pos_y(g, b.y), g.enemies[BEE_ENEMY_IDX].image);
+  }
+}
+
+void focus_on(Game& g, int x, int y) {
+  if (x - g.focus_x > 1) {
+    g.focus_x = x - 1;
+  } else if (g.focus_x - x > 1) {
+    g.focus_x = x + 1;
+  }
+  if (y - g.focus_y > 1) {
+    g.focus_y = y - 1;
+  } else if (g.focus_y - y > 1) {
+    g.focus_y = y + 1;
+  }
+}
+
+void graph_algorithm(Game& g) {
+  bool draw_steps = g_dijkstra_speed > 1;
+
+  const character& ch = g.characters[g.turns.current()];
+  auto& flags_map = *g.ai->flags.find(ch.ai);
+  high_ai_t& high = *g.ai->high.find(ch.ai);
+  auto& data = high.data;
+  auto& graph = high.graph;
+  pos_t start = {ch.pos.x, ch.pos.y};
+
+  // nothing to show at the fastest speed, so don't block the game, a plan
+  // asked for before the speed changed is waited for anyway
+  if (!data.is_planned && (g_dijkstra_speed < 1 || data.job != 0) &&
+      !think_in_background(g, high)) {
+    return;
+  }
+
+  auto can_enter = [&g](int x, int y) {
+    return g.is_walkable(x, y) && !g.is_tile_occupied(x, y);
+  };
+  vector<pos_t> targets = enemy_positions(g, ch);
+  while (!data.is_planned && high.iterations < HIGH_AI_TOTAL_ITERATIONS) {
+    if (walk_reached(data, targets, ch.range)) {
+      if (!data.reached) {
+        data.reached = true;
+        return;
       }
+      data.reached = false;
+      restart_walk(graph, data, flags_map, start, true);
+      ++high.iterations;
+      printf("%d of %d\n", high.iterations, HIGH_AI_TOTAL_ITERATIONS);
+      continue;
     }
-  } else if (ch.stats.intelligence <= HIGH_AI) {
-    auto& data = g_graph_datas.find(g.turns[0])->second;
-    auto it = g_graphs.find(idx);
-
-    Uint8 c;
-    if (it != g_graphs.end()) {
-      auto& graph = it->second;
-      for (size_t y = 0; y < graph.size(); ++y) {
-        for (size_t x = 0; x < graph[0].size(); ++x) {
-          if (!g.materials[g.map[y][x]].is_walkable) {
-            continue;
-          }
-          const node_t& node = graph[y][x];
-          int cx = d.pos_x(g,x) + 32;
-          int cy = d.pos_y(g,y) + 32;
 
-          if (!graph[y][x].visited) {
-            continue;
-          }
+    // randomly fill graph
+    if (!walk_step(can_enter, flags_map, graph, data, g.dice)) {
+      return;
+    }
+    if (data.path.size() >= max_walk(graph)) {
+      restart_walk(graph, data, flags_map, start, false);
+    }
+    if (draw_steps) {
+      focus_on(g, data.x, data.y);
+      return;
+    }
+  }
 
-          static int _min = INT_MAX;
-          static int _max = INT_MIN;
-          if (node.ur > 0 && node.ur < _min)   _min = node.ur;
-          if (node.ur > 0 && node.ur > _max)   _max = node.ur;
-          if (node.u  > 0 && node.ur < _min)   _min = node.u;
-          if (node.u  > 0 && node.ur > _max)   _max = node.u;
-          if (node.ul > 0 && node.ur < _min)   _min = node.ul;
-          if (node.ul > 0 && node.ur > _max)   _max = node.ul;
-          if (node.l  > 0 && node.ur < _min)   _min = node.l;
-          if (node.l  > 0 && node.ur > _max)   _max = node.l;
-          if (node.r  > 0 && node.ur < _min)   _min = node.r;
-          if (node.r  > 0 && node.ur > _max)   _max = node.r;
-          if (node.dr > 0 && node.ur < _min)   _min = node.dr;
-          if (node.dr > 0 && node.ur > _max)   _max = node.dr;
-          if (node.d  > 0 && node.ur < _min)   _min = node.d;
-          if (node.d  > 0 && node.ur > _max)   _max = node.d;
-          if (node.dl > 0 && node.ur < _min)   _min = node.dl;
-          if (node.dl > 0 && node.ur > _max)   _max = node.dl;
-
-          if (node.ur != -1 && graph[y-1][x+1].visited) {
-            c = Uint8(float(node.ur-_min) / (_max-_min) * 255.0f);
-            d.draw_line(cx+16, cy-16, cx+48, cy-48, {c,c,c,255});
-          }
+  // the map changed since the graph was trained, keep what was learned
+  shared_ptr<const graph_topology> topology = shared_maps(g).topology;
+  bool is_stale = &graph.topology() != topology.get();
+  if (is_stale) {
+    graph.rebase(topology);
+  }
 
-          if (node.r != -1 && graph[y][x+1].visited) {
-            c = Uint8(float(node.r-_min) / (_max-_min) * 255.0f);
-            d.draw_line(cx+16, cy, cx+48, cy, {c,c,c,255});
-          }
+  // dijkstra, again when the map changed or the plan doesn't end in range
+  // of the nearest target anymore because it moved
+  const character& dest_ch = g.characters[nearest_character(g)];
+  pos_t dest = {dest_ch.pos.x, dest_ch.pos.y};
+  pos_t end = data.plan.empty() ? start : data.plan.back();
+  if (!in_range(end.x - dest.x, end.y - dest.y, ch.range)) {
+    is_stale = true;
+  }
+  if (!data.is_planned || is_stale) {
+    data.is_planned = true;
+    puts("Calculating Dijkstra's shortest path");
+    dijkstra(graph, start, dest, ch.range, data.plan);
+  }
 
-          if (node.d != -1 && graph[y+1][x].visited) {
-            c = Uint8(float(node.d-_min) / (_max-_min) * 255.0f);
-            d.draw_line(cx, cy+16, cx, cy+48, {c,c,c,255});
-          }
+  // move, a step someone is in the way of is tried again next turn
+  if (data.plan.empty()) {
+    g.end_turn();
+    return;
+  }
+  if (g.move(data.plan.front().x-ch.pos.x, data.plan.front().y-ch.pos.y)) {
+    data.plan.pop_front();
+  } else {
+    g.end_turn();
+  }
+}
 
-          if (node.dr != -1 && graph[y+1][x+1].visited) {
-            c = Uint8(float(node.dr-_min) / (_max-_min) * 255.0f);
-            d.draw_line(cx+16, cy+16, cx+48, cy+48, {c,c,c,255});
-          }
+void path_algorithm(Game& g) {
+  const character& ch = g.characters[g.turns.current()];
+  auto walkable = [&g](int x, int y) {
+    return g.is_walkable(x, y);
+  };
+  auto can_enter = [&g](int x, int y) {
+    return g.is_walkable(x, y) && !g.is_tile_occupied(x, y);
+  };
+
+  // the characters of the other side are the targets, those of this side
+  // are in the way
+  pos_t start = {ch.pos.x, ch.pos.y};
+  vector<pos_t> targets;
+  vector<pos_t> blocked;
+  for (size_t i = 0; i < g.characters.size(); ++i) {
+    const character& ch2 = g.characters.dense(i);
+    pos_t p = {ch2.pos.x, ch2.pos.y};
+    if (ch2.is_playable != ch.is_playable) {
+      targets.push_back(p);
+    } else if (p.x != start.x || p.y != start.y) {
+      blocked.push_back(p);
+    }
+  }
+  int w = g.map.width();
+  int h = g.map.height();
+  bool is_small = size_t(w) * h <= FLOW_FIELD_MAX_TILES;
+  pos_t next;
+  bool has_step;
+  if (is_small) {
+    // one distance map towards every target, computed again whenever they
+    // move, which costs less than repairing a search on small maps
+    g.ai->flow.update(w, h, walkable, targets, g.map_version);
+    has_step = g.ai->flow.next_step(ch.pos.x, ch.pos.y, can_enter, next);
+  } else {
+    // one search back from every target, kept between turns and only
+    // repaired where the targets, the characters in the way or the map
+    // changed
+    g.ai->dstar.update(w, h, walkable, blocked, targets, start,
+                       g.map_version);
+    has_step = g.ai->dstar.next_step(next);
+  }
+  if (has_step && g.move(next.x - ch.pos.x, next.y - ch.pos.y)) {
+    return;
+  }
 
-          /*
-          if (node.ul != -1 && graph[y-1][x-1].visited) {
-            c = Uint8(float(node.ul-_min) / (_max-_min) * 255.0f);
-            d.draw_line(cx-16, cy-16, cx-48, cy-48, {c,c,c,255});
-          }
+  // the step is taken by another character, look for a way around them
+  // over the clusters when the target is a few clusters away, and over the
+  // grid on small maps, D* Lite already found going around dearer than
+  // waiting otherwise
+  const character& dest_ch = g.characters[nearest_character(g)];
+  pos_t dest = {dest_ch.pos.x, dest_ch.pos.y};
+  deque<pos_t> path;
+  int far = HPA_MIN_CLUSTERS * hpa_finder::CLUSTER_TILES;
+  bool found = false;
+  if (abs(dest.x - start.x) > far || abs(dest.y - start.y) > far) {
+    g.ai->hpa.update(w, h, walkable, g.map_version);
+    found = g.ai->hpa.find(walkable, can_enter, start, dest, ch.range, path);
+  }
+  if (!found && is_small) {
+    g.ai->finder.jps(w, h, can_enter, start, dest, ch.range, path);
+  }
+  if (path.empty() || !g.move(path[0].x - ch.pos.x, path[0].y - ch.pos.y)) {
+    g.end_turn();
+  }
+}
 
-          if (node.u != -1 && graph[y-1][x].visited) {
-            c = Uint8(float(node.u-_min) / (_max-_min) * 255.0f);
-            d.draw_line(cx, cy-16, cx, cy-48, {c,c,c,255});
-          }
+void ai_tile_changed(Game& g, int x, int y) {
+  g.ai->hpa.tile_changed(x, y, g.map_version);
+  g.ai->dstar.tile_changed(x, y, g.map_version);
+}
 
-          if (node.l != -1 && graph[y][x-1].visited) {
-            c = Uint8(float(node.l-_min) / (_max-_min) * 255.0f);
-            d.draw_line(cx-16, cy, cx-48, cy, {c,c,c,255});
-          }
+bool is_ai_thinking(const Game& g) {
+  return g.ai->worker->is_busy();
+}
 
-          if (node.dl != -1 && graph[y+1][x-1].visited) {
-            c = Uint8(float(node.dl-_min) / (_max-_min) * 255.0f);
-            d.draw_line(cx-16, cy+16, cx-48, cy+48, {c,c,c,255});
-          }
-          */
+bool is_ai_turn(const Game& g) {
+  slot_handle current = g.turns.current();
+  return g.characters.contains(current) &&
+         !g.characters[current].is_playable && !is_ai_thinking(g);
+}
 
-          d.draw_rect(cx-16, cy-16, 32, 32, {255,255,255,255});
-        }
+void process_ai(Game& g) {
+  poll_plans(g);
+  bool can_take_actions = false;
+  vector<character_handle> list;
+  character& ch = g.characters[g.turns.current()];
+  if (!ch.is_playable && g.ai->frame++ >= g_ai_update) {
+    g.ai->frame = 0;
+
+    list = g.attack_range();
+    if (list.empty()) {
+      // movement depending on intelligence
+      if (ch.stats.intelligence <= LOW_AI) {
+        bresenham_algorithm(g);
+      } else if (ch.stats.intelligence <= MED_AI) {
+        bees_algorithm(g);
+      } else if (ch.stats.intelligence <= HIGH_AI) {
+        graph_algorithm(g);
+      } else {
+        path_algorithm(g);
       }
-      d.draw_rect(d.pos_x(g,data.x)+16, d.pos_y(g,data.y)+16, 32, 32,
-                  {255,255,0,255});
+    } else {
+      g.attack(list[g.dice.roll(list.size())]);
+      g.end_turn();
+    }
+
+    if (can_take_actions) {
+    } else if (g.move_limit == 0) {
+      g.end_turn();
     }
   }
 }
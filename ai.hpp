@@ -2,13 +2,21 @@
 #define AI_HPP
 
 #include <cstddef>
+#include "slot_map.hpp"
 
 class Device;
 class Game;
 
-void create_character_ai(Game& g, size_t idx);
-void delete_character_ai(Game& g, size_t idx);
+void create_character_ai(Game& g, slot_handle ch);
+void delete_character_ai(Game& g, slot_handle ch);
 void process_ai(Game& g);
+// after the tile was edited, so the AI only updates what it changed
+void ai_tile_changed(Game& g, int x, int y);
+// true while an AI plans in the background
+bool is_ai_thinking(const Game& g);
+// true if process_ai has something to do now, an AI character's turn that
+// is not waiting for the background
+bool is_ai_turn(const Game& g);
 void draw_ai(Device& dev, const Game& g);
 
 #endif // AI_HPP
@@ -0,0 +1,117 @@
+#include "ai.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include "ai_state.hpp"
+#include "device.hpp"
+#include "game.hpp"
+
+using namespace std;
+
+void draw_ai(Device& d, const Game& g) {
+  const character& ch = g.characters[g.turns.current()];
+  if (ch.is_playable) {
+    return;
+  }
+  const ai_store& store = *g.ai;
+  const overlay_grid<int>* flags = store.flags.find(ch.ai);
+  if (flags == NULL) {
+    fputs("Error: flags map not created", stderr);
+    return;
+  }
+  auto& flags_map = *flags;
+  // the graph draws lines towards the next tiles
+  int x0, y0, x1, y1;
+  d.visible_tiles(g, x0, y0, x1, y1, 1);
+
+  if (ch.stats.intelligence <= LOW_AI) {
+    for (int y = y0; y < y1; ++y) {
+      for (int x = x0; x < x1; ++x) {
+        if (!g.is_walkable(x, y)) {
+          continue;
+        }
+        float f = flags_map(x, y);
+        Uint8 r = Uint8(f / LOW_AI_OBSTACLE * 255.0f);
+        Uint8 b = 255 - r;
+        SDL_Color color = {r,0,b,255};
+        d.draw_rect(d.pos_x(g,x)+3, d.pos_y(g,y)+3, 57, 57, color);
+        d.draw_rect(d.pos_x(g,x)+4, d.pos_y(g,y)+4, 55, 55, color);
+        d.draw_rect(d.pos_x(g,x)+5, d.pos_y(g,y)+5, 53, 53, color);
+      }
+    }
+  } else if (ch.stats.intelligence <= MED_AI) {
+    for (int y = y0; y < y1; ++y) {
+      for (int x = x0; x < x1; ++x) {
+        if (!g.is_walkable(x, y)) {
+          continue;
+        }
+        float f = flags_map(x, y);
+        Uint8 r = Uint8(f / MED_AI_OBSTACLE * 255.0f);
+        Uint8 b = 255 - r;
+        SDL_Color color = {r,0,b,255};
+        d.draw_rect(d.pos_x(g,x)+3, d.pos_y(g,y)+3, 57, 57, color);
+        d.draw_rect(d.pos_x(g,x)+4, d.pos_y(g,y)+4, 55, 55, color);
+        d.draw_rect(d.pos_x(g,x)+5, d.pos_y(g,y)+5, 53, 53, color);
+      }
+    }
+    const med_ai_t* med = store.med.find(ch.ai);
+    if (med != NULL) {
+      auto& bees = med->bees;
+      for (size_t i = 0; i < bees.size(); ++i) {
+        const auto& b = bees[i];
+        d.draw_sprite(d.pos_x(g, b.x) - g.enemies[BEE_ENEMY_IDX].base_start,
+                      d.pos_y(g, b.y), g.enemies[BEE_ENEMY_IDX].image);
+      }
+    }
+  } else if (ch.stats.intelligence <= HIGH_AI) {
+    const high_ai_t* high = store.high.find(ch.ai);
+
+    Uint8 c;
+    if (high != NULL) {
+      auto& graph = high->graph;
+      auto& data = high->data;
+      for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+          if (!g.is_walkable(x, y)) {
+            continue;
+          }
+          int cx = d.pos_x(g,x) + 32;
+          int cy = d.pos_y(g,y) + 32;
+
+          if (!graph.visited(x, y)) {
+            continue;
+          }
+
+          static int _min = INT_MAX;
+          static int _max = INT_MIN;
+          for (int dir = 0; dir < 9; ++dir) {
+            int weight = dir == 4 ? NO_EDGE : graph.weight(x, y, dir);
+            if (weight != NO_EDGE) {
+              _min = min(_min, weight);
+              _max = max(_max, weight);
+            }
+          }
+
+          // each edge once, the other half is drawn by the neighbor
+          static const int DRAWN[] = {2, 5, 7, 8}; // ur, r, d, dr
+          for (int i = 0; i < 4; ++i) {
+            int dir = DRAWN[i];
+            int dx = dir % 3 - 1;
+            int dy = dir / 3 - 1;
+            weight_t weight = graph.weight(x, y, dir);
+            if (weight == NO_EDGE || !graph.visited(x + dx, y + dy)) {
+              continue;
+            }
+            c = Uint8(float(weight-_min) / max(_max-_min, 1) * 255.0f);
+            d.draw_line(cx+16*dx, cy+16*dy, cx+48*dx, cy+48*dy, {c,c,c,255});
+          }
+
+          d.draw_rect(cx-16, cy-16, 32, 32, {255,255,255,255});
+        }
+      }
+      d.draw_rect(d.pos_x(g,data.x)+16, d.pos_y(g,data.y)+16, 32, 32,
+                  {255,255,0,255});
+    }
+  }
+}
@@ -0,0 +1,160 @@
+#ifndef AI_STATE_HPP
+#define AI_STATE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include "character.hpp"
+#include "chunked_grid.hpp"
+#include "component_pool.hpp"
+#include "dstar.hpp"
+#include "flow_field.hpp"
+#include "hpa.hpp"
+#include "overlay_grid.hpp"
+#include "pathfinding.hpp"
+
+// AI state shared between ai.cpp and the debug drawing in ai_draw.cpp
+
+extern int g_ai_update; // in simulation ticks
+extern int g_dijkstra_speed;
+
+const int LOW_AI = 5;
+const int LOW_AI_OBSTACLE = 5;
+
+const int MED_AI = 10;
+const int MED_AI_OBSTACLE = 10;
+const int MED_AI_NUM_BEES = 5;
+const int MED_AI_TOTAL_BEE_MOVES = 5;
+
+const int HIGH_AI = 100;
+extern int HIGH_AI_TOTAL_ITERATIONS;
+const int HIGH_AI_MAX_WALK = 4; // times the number of tiles
+const int HIGH_AI_TRAINERS = 8; // default random walk streams
+const int HIGH_AI_EPOCH_WALKS = 32; // per trainer between weight updates
+extern int g_ai_threads; // training threads, 0 for one per core
+// random walk streams of a job, the training depends on them and not on
+// the threads, which can't be more than them
+extern int g_ai_trainers;
+
+// low intelligence AI
+typedef struct {
+  std::vector<pos_t> memory; // tiles it went back from, newest last
+  bool is_forgetting;
+} low_ai_t;
+
+// medium intelligence AI
+const int BEE_ENEMY_IDX = 2;
+typedef struct {
+  int x;
+  int y;
+  int last;
+} bee_t;
+typedef struct {
+  std::vector<bee_t> bees;
+  int moves; // of the bees since the character last moved
+} med_ai_t;
+
+// high intelligence AI
+typedef struct {
+  int x;
+  int y;
+  int min;
+  int max;
+  int median;
+  std::deque<short> path;
+  bool reached; // waits one update on reaching a target, to show it
+  bool is_planned; // trained, the plan is made again once it goes stale
+  std::deque<pos_t> plan; // steps left towards the target once planned
+  size_t job; // ticket of the plan being made in the background, 0 if none
+} graph_data_t;
+typedef struct {
+  graph_t graph;
+  graph_data_t data;
+  int iterations; // random walks trained, up to HIGH_AI_TOTAL_ITERATIONS
+} high_ai_t;
+
+// snapshot of the game to train and plan a high intelligence AI without
+// touching the game
+typedef struct {
+  size_t ticket;
+  std::vector<size_t> occupied; // sorted y * w + x, under the characters
+  std::vector<pos_t> targets;
+  pos_t start;
+  int range;
+  int iterations; // random walks left to train
+  int trainers; // random walk streams
+  uint64_t seed;
+  graph_t graph;
+  graph_data_t data;
+} high_ai_job_t;
+
+typedef struct {
+  size_t ticket;
+  int iterations; // random walks done
+  graph_t graph;
+  graph_data_t data; // with the plan
+} high_ai_plan_t;
+
+// trains and plans like graph_algorithm at the fastest speed, safe to call
+// from any thread
+void plan_high_ai(high_ai_job_t& job, high_ai_plan_t& plan);
+
+// pathfinding AI, above high intelligence
+const int HPA_MIN_CLUSTERS = 2; // distance to the target before using them
+// maps up to this big use a flow field instead of D* Lite
+const size_t FLOW_FIELD_MAX_TILES = 64 * 64;
+
+// what every AI on the same map starts from, built once per map version
+typedef struct {
+  int w;
+  int h;
+  size_t map_version;
+  std::shared_ptr<const graph_topology> topology; // built as it is read
+  std::shared_ptr<const chunked_grid<int> > no_flags;
+  // medium intelligence flags by the tile they lead to
+  std::map<size_t, std::shared_ptr<const chunked_grid<int> > >
+      attracted_flags;
+} shared_maps_t;
+
+class ai_worker;
+
+// state of every AI controlled character of a game, by the handle in
+// character::ai
+class ai_store {
+public:
+  ai_store();
+  ~ai_store();
+
+  // handles of destroyed AIs are given out again
+  ai_handle create();
+  void destroy(ai_handle ai);
+
+  // common, on top of flags shared by every AI on the map
+  component_pool<overlay_grid<int> > flags;
+  // by intelligence
+  component_pool<low_ai_t> low;
+  component_pool<med_ai_t> med;
+  component_pool<high_ai_t> high;
+
+  int frame; // simulation ticks since the last AI update
+  shared_maps_t shared;
+
+  // pathfinding AI, shared by everyone chasing playables
+  flow_field flow; // small maps
+  path_finder finder; // ways around characters on small maps
+  dstar_lite dstar; // bigger maps
+  hpa_finder hpa; // far targets
+
+  // high intelligence AI
+  std::unique_ptr<ai_worker> worker; // thinks in the background
+  size_t tickets; // last background job
+
+private:
+  ai_handle _next;
+  std::vector<ai_handle> _free;
+};
+
+#endif // AI_STATE_HPP
@@ -0,0 +1,56 @@
+#include "ai_worker.hpp"
+
+#include <chrono>
+#include <utility>
+
+using namespace std;
+
+const size_t MAX_JOBS = 16;
+const int IDLE_SLEEP_MS = 1;
+
+ai_worker::ai_worker()
+    : _jobs(MAX_JOBS), _plans(MAX_JOBS), _is_running(false), _submitted(0),
+      _received(0) {
+}
+
+ai_worker::~ai_worker() {
+  if (_thread.joinable()) {
+    _is_running = false;
+    _thread.join();
+  }
+}
+
+bool ai_worker::submit(unique_ptr<high_ai_job_t> job) {
+  // every job needs room for its plan
+  if (_submitted - _received >= MAX_JOBS || !_jobs.push(move(job))) {
+    return false;
+  }
+  ++_submitted;
+  if (!_thread.joinable()) {
+    _is_running = true;
+    _thread = thread(&ai_worker::run, this);
+  }
+  return true;
+}
+
+bool ai_worker::poll(unique_ptr<high_ai_plan_t>& plan) {
+  if (!_plans.pop(plan)) {
+    return false;
+  }
+  ++_received;
+  return true;
+}
+
+void ai_worker::run() {
+  unique_ptr<high_ai_job_t> job;
+  while (_is_running) {
+    if (!_jobs.pop(job)) {
+      this_thread::sleep_for(chrono::milliseconds(IDLE_SLEEP_MS));
+      continue;
+    }
+    unique_ptr<high_ai_plan_t> plan(new high_ai_plan_t);
+    plan_high_ai(*job, *plan);
+    job.reset();
+    _plans.push(move(plan));
+  }
+}
@@ -0,0 +1,37 @@
+#ifndef AI_WORKER_HPP
+#define AI_WORKER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include "ai_state.hpp"
+#include "spsc_queue.hpp"
+
+// background thread that trains and plans high intelligence AIs, so the
+// game keeps drawing while they think
+// jobs are snapshots of the game, plans come back through another queue
+class ai_worker {
+public:
+  ai_worker();
+  ~ai_worker();
+
+  // main thread only, false if too many jobs are waiting
+  bool submit(std::unique_ptr<high_ai_job_t> job);
+  // main thread only, false if no plan is ready
+  bool poll(std::unique_ptr<high_ai_plan_t>& plan);
+  // jobs submitted that have not been polled back yet
+  bool is_busy() const { return _submitted != _received; }
+
+private:
+  void run();
+
+  spsc_queue<std::unique_ptr<high_ai_job_t> > _jobs;
+  spsc_queue<std::unique_ptr<high_ai_plan_t> > _plans;
+  std::atomic<bool> _is_running;
+  std::thread _thread; // started with the first job
+  size_t _submitted;
+  size_t _received;
+};
+
+#endif // AI_WORKER_HPP
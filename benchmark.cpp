@@ -0,0 +1,253 @@
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <string>
+#include <vector>
+#include "grid.hpp"
+#include "hpa.hpp"
+#include "map_file.hpp"
+#include "pathfinding.hpp"
+#include "rng.hpp"
+
+using namespace std;
+
+const string MATERIALS_FILENAME = "assets/materials";
+const char* MAP_FILENAMES[] = {
+  "assets/map_blank",
+  "assets/map_fortaleza",
+  "assets/map_intestino",
+  "assets/map_paredes",
+  "assets/map_raffoul"
+};
+const int GENERATED_SIZES[] = {64, 128, 256, 512};
+const int GENERATED_OBSTACLES = 20; // in percent
+
+const int QUERY_TIME_MS = 200; // minimum time spent per measurement
+const size_t MAX_SCAN_TILES = 128 * 128; // the full-grid scan is O(V^2)
+
+typedef grid<tile_t> map_t;
+
+rng g_rng;
+
+map_t load_map(const string& file, const vector<material>& materials) {
+  map_t map;
+  if (!read_map(file, materials, map)) {
+    exit(EXIT_FAILURE);
+  }
+  return map;
+}
+
+map_t generate_map(int size) {
+  map_t map(size, size, 0, TILE_NONE);
+  for (int i = 0; i < size * size * GENERATED_OBSTACLES / 100; ++i) {
+    map(g_rng.roll(size), g_rng.roll(size)) = 3;
+  }
+  return map;
+}
+
+// simulates a trained graph, untrained edges keep their initial weight
+void train_graph(graph_t& graph) {
+  for (int y = 0; y < graph.height(); ++y) {
+    for (int x = 0; x < graph.width(); ++x) {
+      for (int dir = 5; dir < 9; ++dir) { // every edge once
+        if (g_rng.roll(2)) {
+          graph.learn(x, y, dir, g_rng.roll(201) - 100);
+        }
+      }
+    }
+  }
+}
+
+// the original search, scans the whole grid for the next node to visit
+bool dijkstra_scan(const graph_t& graph, pos_t start, pos_t dest, int range,
+                   deque<pos_t>& path) {
+  typedef struct {
+    bool visited;
+    long long dist;
+    pos_t prev;
+  } dijkstra_t;
+
+  dijkstra_t init = {false, LLONG_MAX, {-1, -1}};
+  vector<vector<dijkstra_t> > dijkstra(graph.height(),
+      vector<dijkstra_t>(graph.width(), init));
+  pos_t cur = start;
+  dijkstra[cur.y][cur.x].visited = true;
+  dijkstra[cur.y][cur.x].dist = 0;
+
+  while (abs(cur.x - dest.x) > range || abs(cur.y - dest.y) > range) {
+    const dijkstra_t& d = dijkstra[cur.y][cur.x];
+    for (int dir = 0; dir < 9; ++dir) {
+      int weight = dir == 4 ? NO_EDGE : graph.weight(cur.x, cur.y, dir);
+      if (weight == NO_EDGE) {
+        continue;
+      }
+      dijkstra_t& dn = dijkstra[cur.y + dir / 3 - 1][cur.x + dir % 3 - 1];
+      if (!dn.visited && d.dist + weight < dn.dist) {
+        dn.dist = d.dist + weight;
+        dn.prev = cur;
+      }
+    }
+
+    // find the unvisited node with minimum distance
+    long long min_dist = LLONG_MAX;
+    pos_t min = cur;
+    for (size_t y = 0; y < dijkstra.size(); ++y) {
+      for (size_t x = 0; x < dijkstra[y].size(); ++x) {
+        const dijkstra_t& d = dijkstra[y][x];
+        if (!d.visited && d.dist < min_dist) {
+          min_dist = d.dist;
+          min.x = x;
+          min.y = y;
+        }
+      }
+    }
+    if (min_dist == LLONG_MAX) {
+      return false;
+    }
+    cur = min;
+    dijkstra[cur.y][cur.x].visited = true;
+  }
+
+  path.clear();
+  while (cur.x != start.x || cur.y != start.y) {
+    path.push_front(cur);
+    cur = dijkstra[cur.y][cur.x].prev;
+  }
+  return true;
+}
+
+// average microseconds per query, repeated until QUERY_TIME_MS have passed
+template <class F>
+double measure(F query) {
+  typedef chrono::steady_clock clock_t;
+  clock_t::time_point start = clock_t::now();
+  clock_t::duration elapsed;
+  size_t queries = 0;
+  do {
+    query();
+    ++queries;
+    elapsed = clock_t::now() - start;
+  } while (elapsed < chrono::milliseconds(QUERY_TIME_MS));
+  return chrono::duration<double, micro>(elapsed).count() / queries;
+}
+
+// from the first to the last walkable tile
+void find_ends(const map_t& map, const vector<material>& materials,
+               pos_t& start, pos_t& dest) {
+  start.x = -1;
+  for (int y = 0; y < map.height(); ++y) {
+    for (int x = 0; x < map.width(); ++x) {
+      if (materials[map(x, y)].is_walkable) {
+        if (start.x < 0) {
+          start.x = x;
+          start.y = y;
+        }
+        dest.x = x;
+        dest.y = y;
+      }
+    }
+  }
+}
+
+void run_learned(const string& name, const map_t& map,
+                 const vector<material>& materials) {
+  graph_t graph;
+  graph.assign(map.width(), map.height(), [&](int x, int y) {
+    return materials[map(x, y)].is_walkable;
+  });
+  train_graph(graph);
+  pos_t start, dest;
+  find_ends(map, materials, start, dest);
+
+  deque<pos_t> path;
+  double heap = measure([&]() {
+    dijkstra(graph, start, dest, 1, path, BINARY_HEAP);
+  });
+  double radix = measure([&]() {
+    dijkstra(graph, start, dest, 1, path, RADIX_HEAP);
+  });
+  size_t tiles = size_t(map.width()) * map.height();
+  printf("%-22s %4dx%-4d %6zu ", name.c_str(), map.width(), map.height(),
+         path.size());
+  if (tiles <= MAX_SCAN_TILES) {
+    double scan = measure([&]() {
+      dijkstra_scan(graph, start, dest, 1, path);
+    });
+    printf("%14.1f ", scan);
+  } else {
+    printf("%14s ", "skipped");
+  }
+  printf("%14.1f %14.1f\n", heap, radix);
+}
+
+void run_grid(const string& name, const map_t& map,
+              const vector<material>& materials) {
+  pos_t start, dest;
+  find_ends(map, materials, start, dest);
+  passable_t passable = [&](int x, int y) {
+    return materials[map(x, y)].is_walkable;
+  };
+  int w = map.width();
+  int h = map.height();
+
+  path_finder finder;
+  deque<pos_t> path;
+  size_t expanded[4];
+  double plain = measure([&]() {
+    finder.astar(w, h, passable, start, dest, 1, path, zero);
+  });
+  expanded[0] = finder.expanded();
+  double astar = measure([&]() {
+    finder.astar(w, h, passable, start, dest, 1, path);
+  });
+  expanded[1] = finder.expanded();
+  double jps = measure([&]() {
+    finder.jps(w, h, passable, start, dest, 1, path);
+  });
+  expanded[2] = finder.expanded();
+  // the clusters are built once, like the AI does per map version
+  hpa_finder clusters;
+  clusters.update(w, h, passable, 0);
+  deque<pos_t> hpa_path;
+  double hpa = measure([&]() {
+    clusters.find(passable, passable, start, dest, 1, hpa_path);
+  });
+  expanded[3] = clusters.expanded();
+  printf("%-22s %4dx%-4d %6zu %8.1f %7zu %8.1f %7zu %8.1f %7zu %8.1f %7zu "
+         "%6zu\n", name.c_str(), w, h, path.size(), plain, expanded[0],
+         astar, expanded[1], jps, expanded[2], hpa, expanded[3],
+         hpa_path.size());
+}
+
+template <class F>
+void run_all(F run, const vector<material>& materials) {
+  for (size_t i = 0; i < sizeof(MAP_FILENAMES) / sizeof(*MAP_FILENAMES); ++i) {
+    const char* file = MAP_FILENAMES[i];
+    run(file, load_map(file, materials), materials);
+  }
+  for (size_t i = 0; i < sizeof(GENERATED_SIZES) / sizeof(*GENERATED_SIZES);
+       ++i) {
+    int size = GENERATED_SIZES[i];
+    run("generated", generate_map(size), materials);
+  }
+}
+
+int main(int argc, char** argv) {
+  g_rng.reseed(argc > 1 ? strtoull(argv[1], NULL, 10) : 42);
+  vector<material> materials = read_materials(
+      MATERIALS_FILENAME, [](const string&) { return size_t(0); });
+
+  puts("Learned graph shortest path");
+  printf("%-22s %9s %6s %14s %14s %14s\n", "map", "size", "path",
+         "scan (us)", "heap (us)", "radix (us)");
+  run_all(run_learned, materials);
+
+  puts("\nGrid shortest path (expanded tiles per query)");
+  printf("%-22s %9s %6s %8s %7s %8s %7s %8s %7s %8s %7s %6s\n", "map",
+         "size", "path", "dijk(us)", "exp", "A*(us)", "exp", "jps(us)", "exp",
+         "hpa(us)", "exp", "path");
+  run_all(run_grid, materials);
+  return EXIT_SUCCESS;
+}
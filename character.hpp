@@ -1,8 +1,13 @@
 #ifndef CHARACTER_HPP
 #define CHARACTER_HPP
 
+#include <cstdint>
 #include <string>
 
+// AI state of a character in Game::ai
+typedef uint32_t ai_handle;
+const ai_handle NO_AI = 0;
+
 typedef struct {
   int strength;
   int dexterity;
@@ -34,6 +39,7 @@ typedef struct {
   int range;
   int ammo;
   int damage;
+  ai_handle ai; // NO_AI if nothing controls it
 } character;
 
 #endif // CHARACTER_HPP
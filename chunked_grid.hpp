@@ -0,0 +1,71 @@
+#ifndef CHUNKED_GRID_HPP
+#define CHUNKED_GRID_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// sparse grid split in square chunks, a chunk is only allocated once a cell
+// in it is written, every other cell, the outside included, reads as the
+// value the grid was assigned
+template <class T>
+class chunked_grid {
+public:
+  static const int CHUNK_BITS = 6;
+  static const int CHUNK_TILES = 1 << CHUNK_BITS; // chunk side
+
+  chunked_grid() : _w(0), _h(0), _cols(0), _value() {}
+
+  void assign(int w, int h, const T& value = T()) {
+    _w = w;
+    _h = h;
+    _cols = (w + CHUNK_TILES - 1) >> CHUNK_BITS;
+    _value = value;
+    _chunks.clear();
+    _chunks.resize(size_t(_cols) * ((h + CHUNK_TILES - 1) >> CHUNK_BITS));
+  }
+
+  int width() const { return _w; }
+  int height() const { return _h; }
+  bool contains(int x, int y) const {
+    return x >= 0 && x < _w && y >= 0 && y < _h;
+  }
+
+  const T& operator()(int x, int y) const {
+    if (!contains(x, y)) {
+      return _value;
+    }
+    const T* chunk = _chunks[chunk_of(x, y)].get();
+    return chunk == NULL ? _value : chunk[cell_of(x, y)];
+  }
+
+  // allocates the chunk of the cell, which must be inside the grid
+  T& edit(int x, int y) {
+    std::unique_ptr<T[]>& chunk = _chunks[chunk_of(x, y)];
+    if (!chunk) {
+      chunk.reset(new T[CHUNK_TILES * CHUNK_TILES]);
+      std::fill(chunk.get(), chunk.get() + CHUNK_TILES * CHUNK_TILES, _value);
+    }
+    return chunk[cell_of(x, y)];
+  }
+
+  // chunks by linear index, row by row, and cells inside a chunk, for
+  // grids kept in step with this one
+  size_t chunks() const { return _chunks.size(); }
+  size_t chunk_of(int x, int y) const {
+    return size_t(y >> CHUNK_BITS) * _cols + (x >> CHUNK_BITS);
+  }
+  static size_t cell_of(int x, int y) {
+    return (y & (CHUNK_TILES - 1)) << CHUNK_BITS | (x & (CHUNK_TILES - 1));
+  }
+
+private:
+  int _w;
+  int _h;
+  int _cols; // chunks per row
+  T _value;
+  std::vector<std::unique_ptr<T[]> > _chunks; // NULL until written
+};
+
+#endif // CHUNKED_GRID_HPP
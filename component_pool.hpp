@@ -0,0 +1,67 @@
+#ifndef COMPONENT_POOL_HPP
+#define COMPONENT_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// components stored contiguously and looked up by the handle of their owner
+// in O(1), removing one moves the last component into its place
+template <class T>
+class component_pool {
+public:
+  bool contains(uint32_t owner) const {
+    return owner < _slots.size() && _slots[owner] != NO_SLOT;
+  }
+  T* find(uint32_t owner) {
+    return contains(owner) ? &_items[_slots[owner]] : NULL;
+  }
+  const T* find(uint32_t owner) const {
+    return contains(owner) ? &_items[_slots[owner]] : NULL;
+  }
+
+  // replaces the component if the owner already has one
+  T& add(uint32_t owner, T item) {
+    if (contains(owner)) {
+      return _items[_slots[owner]] = std::move(item);
+    }
+    if (owner >= _slots.size()) {
+      _slots.resize(owner + 1, NO_SLOT);
+    }
+    _slots[owner] = _items.size();
+    _items.push_back(std::move(item));
+    _owners.push_back(owner);
+    return _items.back();
+  }
+
+  void remove(uint32_t owner) {
+    if (!contains(owner)) {
+      return;
+    }
+    uint32_t slot = _slots[owner];
+    if (slot + 1 < _items.size()) {
+      _items[slot] = std::move(_items.back());
+      _owners[slot] = _owners.back();
+      _slots[_owners[slot]] = slot;
+    }
+    _items.pop_back();
+    _owners.pop_back();
+    _slots[owner] = NO_SLOT;
+  }
+
+  // dense access, in no particular order
+  size_t size() const { return _items.size(); }
+  T& operator[](size_t slot) { return _items[slot]; }
+  const T& operator[](size_t slot) const { return _items[slot]; }
+  uint32_t owner(size_t slot) const { return _owners[slot]; }
+
+private:
+  enum { NO_SLOT = UINT32_MAX };
+
+  std::vector<T> _items;
+  std::vector<uint32_t> _owners; // by slot
+  std::vector<uint32_t> _slots; // by owner, NO_SLOT if it has no component
+};
+
+#endif // COMPONENT_POOL_HPP
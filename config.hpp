@@ -0,0 +1,2 @@
+#define VERSION_MAJOR 0
+#define VERSION_MINOR 2
@@ -13,6 +13,7 @@
 #include "ai.hpp"
 #include "material.hpp"
 #include "inputs.hpp"
+#include "rng.hpp"
 
 using namespace std;
 
@@ -20,11 +21,18 @@ const int SCREEN_DEPTH = 32;
 
 const int TILE_SIZE = 64;
 
+const int CHUNK_TILES = 8;
+const int CHUNK_SIZE = CHUNK_TILES * TILE_SIZE; // in pixels
+const size_t MAX_CHUNK_TEXTURES = 32; // 1 MB each
+
 const Uint32 SDL_INIT_FLAGS = SDL_INIT_VIDEO | SDL_INIT_AUDIO;
 
 const char* FONT = "assets/fonts/DejaVuSansMono.ttf";
 const int FONT_SIZE = 18;
 const SDL_Color FONT_COLOR = {0xcc, 0xcc, 0xcc, 0xff};
+const char FIRST_GLYPH = ' ';
+const char LAST_GLYPH = '~';
+const char UNKNOWN_GLYPH = '?';
 
 const SDL_Color MENU_COLOR = {0x1f, 0x0f, 0x45, 0xff};
 
@@ -41,16 +49,15 @@ const int AUDIO_CHANNELS = 2; // stereo
 const int AUDIO_BUFFER_SIZE = 4096;
 
 extern int g_ai_update;
-int g_dijkstra_speed = 2;
+extern int g_dijkstra_speed;
 
 SDL_Window* g_win;
 SDL_Renderer* g_renderer;
 TTF_Font* g_font;
 Mix_Music* g_music;
 
-const Game* g_game;
-bool character_posy_comp(size_t i, size_t j) {
-  return g_game->characters[i].pos.y < g_game->characters[j].pos.y;
+bool character_posy_comp(const character* a, const character* b) {
+  return a->pos.y < b->pos.y;
 }
 
 Device::Device(const int screen_w, const int screen_h) {
@@ -59,6 +66,13 @@ Device::Device(const int screen_w, const int screen_h) {
   random_seed = time(0);
   _width = screen_w;
   _height = screen_h;
+  _font_atlas = NULL;
+  _atlas_w = 0;
+  _atlas_h = 0;
+  _batches_used = 0;
+  _chunks_w = 0;
+  _chunks_h = 0;
+  _frame = 0;
 
   puts("Initializing SDL");
   if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
@@ -104,16 +118,28 @@ Device::Device(const int screen_w, const int screen_h) {
 
   puts("Creating renderer");
   g_renderer = SDL_CreateRenderer(g_win, -1,
-                         SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+                         SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC |
+                         SDL_RENDERER_TARGETTEXTURE);
   if (g_renderer == NULL) {
     fprintf(stderr, "%s\n", SDL_GetError());
     SDL_Quit();
     exit(EXIT_FAILURE);
   }
+  _use_chunks = SDL_RenderTargetSupported(g_renderer);
+  if (!_use_chunks) {
+    puts("Render targets not supported, drawing the map tile by tile");
+  }
+
+  puts("Creating font atlas");
+  create_font_atlas();
 }
 
 Device::~Device() {
   puts("Destroying textures");
+  destroy_chunks();
+  if (_font_atlas != NULL) {
+    SDL_DestroyTexture(_font_atlas);
+  }
   for (size_t i = 0; i < _textures.size(); ++i) {
     SDL_DestroyTexture(_textures[i]);
   }
@@ -170,6 +196,10 @@ bool Device::process_events(Game& game) {
   bool is_running = true;
   SDL_Event event;
   while (SDL_PollEvent(&event)) {
+    if (event.type == SDL_RENDER_TARGETS_RESET) {
+      // the contents of the chunk textures are lost
+      invalidate_map();
+    }
     is_running &= process_input(event, *this, game);
   }
   return is_running;
@@ -180,54 +210,217 @@ void Device::clear_screen() {
   SDL_RenderClear(g_renderer);
 }
 
+Device::batch_t& Device::batch(const SDL_Color& c) {
+  Uint32 key = Uint32(c.r) << 24 | c.g << 16 | c.b << 8 | c.a;
+  map<Uint32,size_t>::iterator it = _batches_idx.find(key);
+  if (it != _batches_idx.end()) {
+    return _batches[it->second];
+  }
+  if (_batches_used == _batches.size()) {
+    _batches.resize(_batches.size() + 1);
+  }
+  _batches_idx.insert(make_pair(key, _batches_used));
+  batch_t& b = _batches[_batches_used++];
+  b.color = c;
+  return b;
+}
+
+void Device::flush() {
+  for (size_t i = 0; i < _batches_used; ++i) {
+    batch_t& b = _batches[i];
+    SDL_SetRenderDrawColor(g_renderer, b.color.r, b.color.g, b.color.b,
+                           b.color.a);
+    if (!b.fill_rects.empty()) {
+      SDL_RenderFillRects(g_renderer, b.fill_rects.data(),
+                          b.fill_rects.size());
+    }
+    if (!b.rects.empty()) {
+      SDL_RenderDrawRects(g_renderer, b.rects.data(), b.rects.size());
+    }
+    for (size_t j = 0; j < b.lines.size(); j += 2) {
+      SDL_RenderDrawLine(g_renderer, b.lines[j].x, b.lines[j].y,
+                         b.lines[j + 1].x, b.lines[j + 1].y);
+    }
+    // keep the memory for the next frame
+    b.fill_rects.clear();
+    b.rects.clear();
+    b.lines.clear();
+  }
+  _batches_used = 0;
+  _batches_idx.clear();
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+  if (!_line_vertices.empty()) {
+    SDL_RenderGeometry(g_renderer, NULL, _line_vertices.data(),
+                       _line_vertices.size(), _line_indices.data(),
+                       _line_indices.size());
+    _line_vertices.clear();
+    _line_indices.clear();
+  }
+#endif
+}
+
 void Device::draw_line(int x1, int y1, int x2, int y2, const SDL_Color& c) {
-  SDL_SetRenderDrawColor(g_renderer, c.r, c.g, c.b, c.a);
-  SDL_RenderDrawLine(g_renderer, x1, y1, x2, y2);
+#if SDL_VERSION_ATLEAST(2,0,18)
+  // one pixel wide quad covering both end pixels, all the lines of a frame
+  // go in a single draw call
+  float dx = x2 - x1;
+  float dy = y2 - y1;
+  float len = sqrt(dx * dx + dy * dy);
+  if (len == 0.0f) {
+    dx = 1.0f;
+    len = 1.0f;
+  }
+  dx *= 0.5f / len;
+  dy *= 0.5f / len;
+  int first = _line_vertices.size();
+  SDL_Vertex v;
+  v.color = c;
+  v.tex_coord.x = 0.0f;
+  v.tex_coord.y = 0.0f;
+  v.position.x = x1 + 0.5f - dx + dy;
+  v.position.y = y1 + 0.5f - dy - dx;
+  _line_vertices.push_back(v);
+  v.position.x = x1 + 0.5f - dx - dy;
+  v.position.y = y1 + 0.5f - dy + dx;
+  _line_vertices.push_back(v);
+  v.position.x = x2 + 0.5f + dx - dy;
+  v.position.y = y2 + 0.5f + dy + dx;
+  _line_vertices.push_back(v);
+  v.position.x = x2 + 0.5f + dx + dy;
+  v.position.y = y2 + 0.5f + dy - dx;
+  _line_vertices.push_back(v);
+  const int QUAD[] = {0, 1, 2, 0, 2, 3};
+  for (int i = 0; i < 6; ++i) {
+    _line_indices.push_back(first + QUAD[i]);
+  }
+#else
+  batch_t& b = batch(c);
+  SDL_Point p1 = {x1, y1};
+  SDL_Point p2 = {x2, y2};
+  b.lines.push_back(p1);
+  b.lines.push_back(p2);
+#endif
 }
 
 void Device::draw_rect(int x, int y, int w, int h, const SDL_Color& c) {
-  SDL_SetRenderDrawColor(g_renderer, c.r, c.g, c.b, c.a);
   SDL_Rect rect;
   rect.x = x;
   rect.y = y;
   rect.w = w;
   rect.h = h;
-  SDL_RenderDrawRect(g_renderer, &rect);
+  batch(c).rects.push_back(rect);
 }
 
 void Device::draw_fill_rect(int x, int y, int w, int h, const SDL_Color& c) {
-  SDL_SetRenderDrawColor(g_renderer, c.r, c.g, c.b, c.a);
   SDL_Rect rect;
   rect.x = x;
   rect.y = y;
   rect.w = w;
   rect.h = h;
-  SDL_RenderFillRect(g_renderer, &rect);
+  batch(c).fill_rects.push_back(rect);
+}
+
+// renders every printable ascii glyph side by side in a single texture, so
+// text never has to be rendered again
+void Device::create_font_atlas() {
+  vector<SDL_Surface*> surfaces;
+  _atlas_w = 0;
+  _atlas_h = TTF_FontHeight(g_font);
+  for (char c = FIRST_GLYPH; c <= LAST_GLYPH; ++c) {
+    glyph_t glyph;
+    int minx, maxx, miny, maxy;
+    TTF_GlyphMetrics(g_font, c, &minx, &maxx, &miny, &maxy, &glyph.advance);
+    SDL_Surface* s = TTF_RenderGlyph_Blended(g_font, c, FONT_COLOR);
+    glyph.src.x = _atlas_w;
+    glyph.src.y = 0;
+    glyph.src.w = s == NULL ? 0 : s->w;
+    glyph.src.h = s == NULL ? 0 : s->h;
+    _atlas_w += glyph.src.w;
+    _atlas_h = max(_atlas_h, glyph.src.h);
+    _glyphs.push_back(glyph);
+    surfaces.push_back(s);
+  }
+
+  SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(0, _atlas_w, _atlas_h,
+                                                      32,
+                                                      SDL_PIXELFORMAT_RGBA32);
+  if (atlas == NULL) {
+    fprintf(stderr, "%s\n", SDL_GetError());
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < surfaces.size(); ++i) {
+    if (surfaces[i] == NULL) {
+      continue;
+    }
+    // copy the alpha channel as is
+    SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+    SDL_Rect dest = _glyphs[i].src;
+    SDL_BlitSurface(surfaces[i], NULL, atlas, &dest);
+    SDL_FreeSurface(surfaces[i]);
+  }
+  _font_atlas = SDL_CreateTextureFromSurface(g_renderer, atlas);
+  SDL_FreeSurface(atlas);
+  if (_font_atlas == NULL) {
+    fprintf(stderr, "%s\n", SDL_GetError());
+    exit(EXIT_FAILURE);
+  }
+  SDL_SetTextureBlendMode(_font_atlas, SDL_BLENDMODE_BLEND);
 }
 
 void Device::draw_text(int x, int y, const string& text) {
-  size_t idx = 0;
-  SDL_Texture* tex;
-  map<string,size_t>::iterator it = _texts_idx.find(text);
-  if (it != _texts_idx.end()) {
-    idx = it->second;
-    tex = _textures[idx];
-  } else {
-    SDL_Surface* s = TTF_RenderText_Blended(g_font, text.c_str(), FONT_COLOR);
-    tex = SDL_CreateTextureFromSurface(g_renderer, s);
-    SDL_FreeSurface(s);
-    idx = _textures.size();
-    _texts_idx.insert(make_pair(text, idx));
-    _textures.push_back(tex);
+  flush();
+#if SDL_VERSION_ATLEAST(2,0,18)
+  // the whole string in one draw call
+  _text_vertices.clear();
+  _text_indices.clear();
+  SDL_Vertex v;
+  v.color.r = 255;
+  v.color.g = 255;
+  v.color.b = 255;
+  v.color.a = 255;
+  const int QUAD[] = {0, 1, 2, 0, 2, 3};
+#endif
+  for (size_t i = 0; i < text.size(); ++i) {
+    char c = text[i];
+    if (c < FIRST_GLYPH || c > LAST_GLYPH) {
+      c = UNKNOWN_GLYPH;
+    }
+    const glyph_t& glyph = _glyphs[c - FIRST_GLYPH];
+    SDL_Rect dest = {x, y, glyph.src.w, glyph.src.h};
+    x += glyph.advance;
+    if (c == ' ') {
+      continue;
+    }
+#if SDL_VERSION_ATLEAST(2,0,18)
+    int first = _text_vertices.size();
+    for (int corner = 0; corner < 4; ++corner) {
+      int dx = corner == 1 || corner == 2;
+      int dy = corner >= 2;
+      v.position.x = dest.x + dx * dest.w;
+      v.position.y = dest.y + dy * dest.h;
+      v.tex_coord.x = float(glyph.src.x + dx * glyph.src.w) / _atlas_w;
+      v.tex_coord.y = float(glyph.src.y + dy * glyph.src.h) / _atlas_h;
+      _text_vertices.push_back(v);
+    }
+    for (int j = 0; j < 6; ++j) {
+      _text_indices.push_back(first + QUAD[j]);
+    }
+#else
+    SDL_RenderCopy(g_renderer, _font_atlas, &glyph.src, &dest);
+#endif
   }
-  SDL_Rect dest;
-  dest.x = x;
-  dest.y = y;
-  SDL_QueryTexture(tex, NULL, NULL, &dest.w, &dest.h);
-  SDL_RenderCopy(g_renderer, tex, NULL, &dest);
+#if SDL_VERSION_ATLEAST(2,0,18)
+  if (!_text_vertices.empty()) {
+    SDL_RenderGeometry(g_renderer, _font_atlas, _text_vertices.data(),
+                       _text_vertices.size(), _text_indices.data(),
+                       _text_indices.size());
+  }
+#endif
 }
 
 void Device::draw_sprite(int x, int y, int image_idx) {
+  flush();
   SDL_Rect dest;
   SDL_Texture* tex = _textures[image_idx];
   SDL_QueryTexture(tex, NULL, NULL, &dest.w, &dest.h);
@@ -236,62 +429,197 @@ void Device::draw_sprite(int x, int y, int image_idx) {
   SDL_RenderCopy(g_renderer, tex, NULL, &dest);
 }
 
-void Device::draw_game(const Game& g) {
-  g_game = &g;
-
-  srand(42);
+// tiles from (x0, y0) to (x1, y1) excluding the last ones, with their grid
+// lines, the first one drawn at (dest_x, dest_y)
+void Device::draw_tiles(const Game& g, int x0, int y0, int x1, int y1,
+                        int dest_x, int dest_y) {
   SDL_Rect src, dest;
   src.w = TILE_SIZE;
   src.h = TILE_SIZE;
   dest.w = TILE_SIZE;
   dest.h = TILE_SIZE;
-  const int SQR = TILE_SIZE - 1;
-
-  // draw map
-  const character& ch1 = g.characters[g.turns[0]];
-  for (size_t y = 0; y < g.map.size(); ++y) {
-    for (size_t x = 0; x < g.map[0].size(); ++x) {
-      size_t m = g.map[y][x];
-      const material& mat = g.materials[m];
-      src.x = mat.pos_x + (rand() % mat.n_x) * TILE_SIZE;
-      src.y = mat.pos_y + (rand() % mat.n_y) * TILE_SIZE;
-      dest.x = pos_x(g, x);
-      dest.y = pos_y(g, y);
+  for (int y = y0; y < y1; ++y) {
+    for (int x = x0; x < x1; ++x) {
+      const material& mat = g.materials[g.map(x, y)];
+      // the same variant of the material every frame
+      uint32_t variant = hash_tile(x, y);
+      src.x = mat.pos_x + (variant % mat.n_x) * TILE_SIZE;
+      src.y = mat.pos_y + (variant / mat.n_x % mat.n_y) * TILE_SIZE;
+      dest.x = dest_x + (x - x0) * TILE_SIZE;
+      dest.y = dest_y + (y - y0) * TILE_SIZE;
       SDL_RenderCopy(g_renderer, _textures[mat.image], &src, &dest);
+    }
+  }
 
-      // draw attack range
-      if (is_edit_mode) {
-        continue;
+  // draw grid
+  int w = (x1 - x0) * TILE_SIZE;
+  int h = (y1 - y0) * TILE_SIZE;
+  for (int i = TILE_SIZE - 1; i < h; i += TILE_SIZE) {
+    draw_line(dest_x, dest_y + i, dest_x + w - 1, dest_y + i, BG_COLOR);
+  }
+  for (int i = TILE_SIZE - 1; i < w; i += TILE_SIZE) {
+    draw_line(dest_x + i, dest_y, dest_x + i, dest_y + h - 1, BG_COLOR);
+  }
+}
+
+void Device::draw_terrain(const Game& g) {
+  flush();
+  int x0, y0, x1, y1;
+  visible_tiles(g, x0, y0, x1, y1);
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+  if (!_use_chunks) {
+    draw_tiles(g, x0, y0, x1, y1, pos_x(g, x0), pos_y(g, y0));
+    return;
+  }
+
+  // a new map was loaded
+  int chunks_w = (g.map.width() + CHUNK_TILES - 1) / CHUNK_TILES;
+  int chunks_h = (g.map.height() + CHUNK_TILES - 1) / CHUNK_TILES;
+  if (chunks_w != _chunks_w || chunks_h != _chunks_h) {
+    destroy_chunks();
+    _chunks_w = chunks_w;
+    _chunks_h = chunks_h;
+  }
+
+  ++_frame;
+  SDL_Rect dest;
+  dest.w = CHUNK_SIZE;
+  dest.h = CHUNK_SIZE;
+  for (int cy = y0 / CHUNK_TILES; cy <= (y1 - 1) / CHUNK_TILES; ++cy) {
+    for (int cx = x0 / CHUNK_TILES; cx <= (x1 - 1) / CHUNK_TILES; ++cx) {
+      dest.x = pos_x(g, cx * CHUNK_TILES);
+      dest.y = pos_y(g, cy * CHUNK_TILES);
+      size_t key = size_t(cy) * _chunks_w + cx;
+      map<size_t,chunk_t>::iterator it = _chunks.find(key);
+      if (it == _chunks.end()) {
+        if (_chunks.size() >= MAX_CHUNK_TEXTURES) {
+          evict_chunk();
+        }
+        SDL_Texture* tex = SDL_CreateTexture(g_renderer,
+                                             SDL_PIXELFORMAT_RGBA8888,
+                                             SDL_TEXTUREACCESS_TARGET,
+                                             CHUNK_SIZE, CHUNK_SIZE);
+        if (tex == NULL) {
+          fprintf(stderr, "%s\n", SDL_GetError());
+          continue;
+        }
+        chunk_t chunk = {tex, true, 0};
+        it = _chunks.insert(make_pair(key, chunk)).first;
       }
-      double dist_x = abs(double(ch1.pos.x) - x);
-      double dist_y = abs(double(ch1.pos.y) - y);
-      int dist = pow(dist_x * dist_x + dist_y * dist_y, 0.5) + 0.5;
-      if (g.materials[g.map[y][x]].is_walkable && dist <= ch1.range) {
-        draw_rect(dest.x, dest.y, SQR, SQR, {255,255,0,255});
+      chunk_t& chunk = it->second;
+      if (chunk.is_dirty) {
+        bake_chunk(g, chunk, cx, cy);
       }
+      chunk.last_used = _frame;
+      SDL_RenderCopy(g_renderer, chunk.tex, NULL, &dest);
     }
   }
+}
 
-  // draw grid
-  for (int i = TILE_SIZE - 1; i < _height; i += TILE_SIZE) {
-    draw_line(0, i, _width, i, BG_COLOR);
+void Device::bake_chunk(const Game& g, chunk_t& chunk, int cx, int cy) {
+  int x0 = cx * CHUNK_TILES;
+  int y0 = cy * CHUNK_TILES;
+  int x1 = min(x0 + CHUNK_TILES, g.map.width());
+  int y1 = min(y0 + CHUNK_TILES, g.map.height());
+  SDL_SetRenderTarget(g_renderer, chunk.tex);
+  SDL_SetRenderDrawColor(g_renderer, BG_R, BG_G, BG_B, BG_A);
+  SDL_RenderClear(g_renderer);
+  draw_tiles(g, x0, y0, x1, y1, 0, 0);
+  flush(); // the grid lines
+  SDL_SetRenderTarget(g_renderer, NULL);
+  chunk.is_dirty = false;
+}
+
+// frees the texture of the chunk that has not been drawn for the longest
+void Device::evict_chunk() {
+  map<size_t,chunk_t>::iterator oldest = _chunks.end();
+  for (map<size_t,chunk_t>::iterator it = _chunks.begin();
+       it != _chunks.end(); ++it) {
+    if (oldest == _chunks.end() ||
+        it->second.last_used < oldest->second.last_used) {
+      oldest = it;
+    }
+  }
+  if (oldest != _chunks.end()) {
+    SDL_DestroyTexture(oldest->second.tex);
+    _chunks.erase(oldest);
   }
-  for (int i = TILE_SIZE - 1; i < _width; i += TILE_SIZE) {
-    draw_line(i, 0, i, _height, BG_COLOR);
+}
+
+void Device::destroy_chunks() {
+  for (map<size_t,chunk_t>::iterator it = _chunks.begin();
+       it != _chunks.end(); ++it) {
+    SDL_DestroyTexture(it->second.tex);
+  }
+  _chunks.clear();
+  _chunks_w = 0;
+  _chunks_h = 0;
+}
+
+void Device::invalidate_tile(int x, int y) {
+  int cx = x / CHUNK_TILES;
+  int cy = y / CHUNK_TILES;
+  if (x >= 0 && y >= 0 && cx < _chunks_w && cy < _chunks_h) {
+    map<size_t,chunk_t>::iterator it =
+        _chunks.find(size_t(cy) * _chunks_w + cx);
+    if (it != _chunks.end()) {
+      it->second.is_dirty = true;
+    }
+  }
+}
+
+void Device::invalidate_map() {
+  for (map<size_t,chunk_t>::iterator it = _chunks.begin();
+       it != _chunks.end(); ++it) {
+    it->second.is_dirty = true;
+  }
+}
+
+void Device::draw_game(const Game& g) {
+  SDL_Rect dest;
+  dest.w = TILE_SIZE;
+  dest.h = TILE_SIZE;
+  const int SQR = TILE_SIZE - 1;
+
+  // draw map
+  draw_terrain(g);
+
+  // draw attack range
+  const character& ch1 = g.characters[g.turns.current()];
+  if (!is_edit_mode) {
+    for (int y = max(ch1.pos.y - ch1.range, 0);
+         y <= min(ch1.pos.y + ch1.range, g.map.height() - 1); ++y) {
+      for (int x = max(ch1.pos.x - ch1.range, 0);
+           x <= min(ch1.pos.x + ch1.range, g.map.width() - 1); ++x) {
+        if (g.is_walkable(x, y) &&
+            in_range(x - ch1.pos.x, y - ch1.pos.y, ch1.range)) {
+          draw_rect(pos_x(g, x), pos_y(g, y), SQR, SQR, {255,255,0,255});
+        }
+      }
+    }
   }
 
   // draw AI
   draw_ai(*this, g);
 
-  // draw characters
+  // draw characters, sprites can be larger than their base
   SDL_Color color;
-  vector<size_t> sorted(g.characters.size());
-  for (size_t i = 0; i < sorted.size(); ++i) {
-    sorted[i] = i;
+  int x0, y0, x1, y1;
+  visible_tiles(g, x0, y0, x1, y1, 2);
+  vector<const character*> sorted;
+  for (size_t i = 0; i < g.characters.size(); ++i) {
+    const character& ch = g.characters.dense(i);
+    const position& pos = ch.pos;
+    int size = ch.base_size;
+    if (pos.x + size > x0 && pos.x < x1 && pos.y + size > y0 && pos.y < y1) {
+      sorted.push_back(&ch);
+    }
   }
   sort(sorted.begin(), sorted.end(), character_posy_comp);
   for (size_t i = 0; i < sorted.size(); ++i) {
-    const character& ch = g.characters[sorted[i]];
+    const character& ch = *sorted[i];
     if (ch.is_playable) {
       color = {0,255,255,255};
     } else {
@@ -348,7 +676,7 @@ void Device::draw_game(const Game& g) {
     draw_text(10, 325, "[8]  Toggle Grick");
     draw_text(10, 345, "[7]  Toggle Cockatrice");
   } else {
-    const character& ch = g.characters[g.turns[0]];
+    const character& ch = g.characters[g.turns.current()];
     draw_text(400,  5, ch.name);
     draw_text(400, 25, "HP: " + to_string(ch.hp) + "/" + to_string(ch.hp_max));
     draw_text(10,   5, "Mode: Battle");
@@ -381,38 +709,40 @@ void Device::draw_game(const Game& g) {
 }
 
 void Device::render() {
+  flush();
   SDL_RenderPresent(g_renderer);
 }
 
 void Device::randomize_map(Game& g) {
-  float total = g.map[0].size() * g.map.size();
+  float total = g.map.width() * g.map.height();
   int obstacles = total * random_obstacles * 0.01;
-  size_t x, y;
+  int x, y;
 
-  srand(clock());
   // clear map
-  for (y = 0; y < g.map.size(); ++y) {
-    for (x = 0; x < g.map[0].size(); ++x) {
-      int temp = rand() % 10;
+  for (y = 0; y < g.map.height(); ++y) {
+    for (x = 0; x < g.map.width(); ++x) {
+      int temp = g.dice.roll(10);
       if (temp < 5) {
-        g.map[y][x] = 0;
+        g.map.set(x, y, 0);
       } else if (temp < 9) {
-        g.map[y][x] = 1;
+        g.map.set(x, y, 1);
       } else {
-        g.map[y][x] = 2;
+        g.map.set(x, y, 2);
       }
     }
   }
 
   // place obstacles
-  srand(random_seed);
+  rng obstacles_rng(random_seed);
   for (int i = 0; i < obstacles; ++i) {
     do {
-      x = rand() % g.map[0].size();
-      y = rand() % g.map.size();
-    } while (g.map[y][x] == 3);
-    g.map[y][x] = 3;
+      x = obstacles_rng.roll(g.map.width());
+      y = obstacles_rng.roll(g.map.height());
+    } while (g.map(x, y) == 3);
+    g.map.set(x, y, 3);
   }
+  ++g.map_version;
+  invalidate_map();
 }
 
 
@@ -424,3 +754,17 @@ int Device::pos_x(const Game& g, int x) {
 int Device::pos_y(const Game& g, int y) {
   return (y - g.focus_y) * TILE_SIZE + _height / 2;
 }
+
+void Device::visible_tiles(const Game& g, int& x0, int& y0, int& x1, int& y1,
+                           int margin) {
+  // inverse of pos_x and pos_y, rounding outwards
+  x0 = g.focus_x - (_width / 2 + TILE_SIZE - 1) / TILE_SIZE - margin;
+  y0 = g.focus_y - (_height / 2 + TILE_SIZE - 1) / TILE_SIZE - margin;
+  x1 = g.focus_x + (_width - _width / 2 + TILE_SIZE - 1) / TILE_SIZE + margin;
+  y1 = g.focus_y + (_height - _height / 2 + TILE_SIZE - 1) / TILE_SIZE +
+       margin;
+  x0 = max(x0, 0);
+  y0 = max(y0, 0);
+  x1 = min(x1, g.map.width());
+  y1 = min(y1, g.map.height());
+}
@@ -23,6 +23,9 @@ public:
   size_t load_image(const std::string& filename);
   bool process_events(Game& game);
   void clear_screen();
+  // lines and rectangles are queued by color and drawn together on flush,
+  // sprites, text and render flush the queue first to keep the draw order
+  void flush();
   void draw_line(int x1, int y1, int x2, int y2, const SDL_Color& c);
   void draw_rect(int x, int y, int w, int h, const SDL_Color& c);
   void draw_fill_rect(int x, int y, int w, int h, const SDL_Color& c);
@@ -31,15 +34,69 @@ public:
   void draw_game(const Game& g);
   void render();
   void randomize_map(Game& g);
+  // the terrain is cached, call these after changing g.map
+  void invalidate_tile(int x, int y);
+  void invalidate_map();
   int pos_x(const Game& g, int x);
   int pos_y(const Game& g, int y);
+  // map tiles on screen from (x0, y0) to (x1, y1) excluding the last ones,
+  // widened by margin tiles for things that stick out of their tile
+  void visible_tiles(const Game& g, int& x0, int& y0, int& x1, int& y1,
+                     int margin = 0);
 
 private:
+  // pre-rendered block of CHUNK_TILES x CHUNK_TILES terrain tiles
+  typedef struct {
+    SDL_Texture* tex;
+    bool is_dirty;
+    size_t last_used; // frame it was last drawn
+  } chunk_t;
+
+  // primitives of the same color waiting to be drawn
+  typedef struct {
+    SDL_Color color;
+    std::vector<SDL_Rect> rects;
+    std::vector<SDL_Rect> fill_rects;
+    std::vector<SDL_Point> lines; // pairs of end points
+  } batch_t;
+
+  // printable ascii character in the font atlas
+  typedef struct {
+    SDL_Rect src;
+    int advance;
+  } glyph_t;
+
   int _width;
   int _height;
+  SDL_Texture* _font_atlas; // every glyph rendered once
+  int _atlas_w;
+  int _atlas_h;
+  std::vector<glyph_t> _glyphs;
+  std::vector<SDL_Vertex> _text_vertices;
+  std::vector<int> _text_indices;
+  std::vector<batch_t> _batches; // only the first _batches_used are queued
+  size_t _batches_used;
+  std::map<Uint32,size_t> _batches_idx; // by color
+  std::vector<SDL_Vertex> _line_vertices; // lines as quads if supported
+  std::vector<int> _line_indices;
+  bool _use_chunks; // false if the renderer can't draw to textures
+  int _chunks_w;
+  int _chunks_h;
+  size_t _frame;
+  // only the chunks with a texture, by cy * _chunks_w + cx, so huge maps
+  // cost nothing until they are seen
+  std::map<size_t,chunk_t> _chunks;
   std::vector<SDL_Texture*> _textures;
   std::map<std::string,size_t> _textures_idx;
-  std::map<std::string,size_t> _texts_idx;
+
+  void create_font_atlas();
+  batch_t& batch(const SDL_Color& c);
+  void draw_tiles(const Game& g, int x0, int y0, int x1, int y1, int dest_x,
+                  int dest_y);
+  void draw_terrain(const Game& g);
+  void bake_chunk(const Game& g, chunk_t& chunk, int cx, int cy);
+  void evict_chunk();
+  void destroy_chunks();
 };
 
 #endif // DEVICE_HPP
@@ -0,0 +1,281 @@
+#include "dstar.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+
+using namespace std;
+
+vector<size_t> sorted_tiles(const vector<pos_t>& positions, int w) {
+  vector<size_t> tiles;
+  for (size_t i = 0; i < positions.size(); ++i) {
+    tiles.push_back(size_t(positions[i].y) * w + positions[i].x);
+  }
+  sort(tiles.begin(), tiles.end());
+  tiles.erase(unique(tiles.begin(), tiles.end()), tiles.end());
+  return tiles;
+}
+
+const int dstar_lite::INF;
+const size_t dstar_lite::MIN_OPEN;
+const size_t dstar_lite::NO_TILE;
+
+dstar_lite::dstar_lite() : _w(0), _h(0), _map_version(0), _walkable(NULL),
+                           _is_reset(true), _start(0), _km(0), _next(NO_TILE),
+                           _compact_size(MIN_OPEN), _expanded(0) {
+}
+
+void dstar_lite::update(int w, int h, const passable_t& walkable,
+                        const vector<pos_t>& blocked,
+                        const vector<pos_t>& targets, pos_t start,
+                        size_t map_version) {
+  _expanded = 0;
+  if (w != _w || h != _h || map_version != _map_version) {
+    reset(w, h, map_version);
+  }
+  _walkable = &walkable;
+  vector<size_t> target_tiles = sorted_tiles(targets, w);
+  vector<size_t> blocked_tiles = sorted_tiles(blocked, w);
+  size_t s = tile_at(start.x, start.y);
+
+  if (_is_reset) {
+    _is_reset = false;
+    _start = s;
+    _targets.swap(target_tiles);
+    _blocked.swap(blocked_tiles);
+    for (size_t i = 0; i < _targets.size(); ++i) {
+      update_tile(_targets[i]);
+    }
+  } else {
+    // the estimates to the new start are at most this much lower
+    _km += estimate(s);
+    _start = s;
+
+    // targets that moved stop being the end of the way where they were
+    vector<size_t> moved;
+    set_symmetric_difference(target_tiles.begin(), target_tiles.end(),
+                             _targets.begin(), _targets.end(),
+                             back_inserter(moved));
+    _targets.swap(target_tiles);
+    for (size_t i = 0; i < moved.size(); ++i) {
+      update_tile(moved[i]);
+    }
+
+    // characters that moved changed the cost of entering the tiles they left
+    // and took, edited tiles the cost of entering and leaving them
+    moved.clear();
+    set_symmetric_difference(blocked_tiles.begin(), blocked_tiles.end(),
+                             _blocked.begin(), _blocked.end(),
+                             back_inserter(moved));
+    _blocked.swap(blocked_tiles);
+    for (size_t i = 0; i < moved.size(); ++i) {
+      update_neighbors(moved[i]);
+    }
+    for (size_t i = 0; i < _changed.size(); ++i) {
+      update_tile(_changed[i]);
+      update_neighbors(_changed[i]);
+    }
+  }
+  _changed.clear();
+  if (_open.size() > _compact_size || _km > INF / 2) {
+    compact();
+  }
+  compute();
+  _next = first_step();
+  _walkable = NULL;
+}
+
+void dstar_lite::tile_changed(int x, int y, size_t map_version) {
+  // changes missed before this one mean starting over anyway
+  if (_is_reset || map_version != _map_version + 1 ||
+      x < 0 || x >= _w || y < 0 || y >= _h) {
+    return;
+  }
+  _map_version = map_version;
+  _changed.push_back(tile_at(x, y));
+}
+
+int dstar_lite::dist() const {
+  if (_is_reset || g(_start) >= INF) {
+    return -1;
+  }
+  return g(_start);
+}
+
+bool dstar_lite::next_step(pos_t& next) const {
+  if (_next == NO_TILE) {
+    return false;
+  }
+  next.x = x_of(_next);
+  next.y = y_of(_next);
+  return true;
+}
+
+void dstar_lite::reset(int w, int h, size_t map_version) {
+  _w = w;
+  _h = h;
+  _map_version = map_version;
+  _is_reset = true;
+  _km = 0;
+  _next = NO_TILE;
+  _targets.clear();
+  _blocked.clear();
+  _changed.clear();
+  node_t none = {INF, INF, priority_t(INF, INF), false};
+  _nodes.assign(w, h, none);
+  _open.clear();
+  _compact_size = MIN_OPEN;
+}
+
+bool dstar_lite::is_walkable(size_t tile) const {
+  return (*_walkable)(x_of(tile), y_of(tile));
+}
+
+int dstar_lite::cost(size_t from, size_t to) const {
+  int c = x_of(from) != x_of(to) && y_of(from) != y_of(to) ? DIAGONAL_COST
+                                                           : STRAIGHT_COST;
+  if (binary_search(_blocked.begin(), _blocked.end(), to)) {
+    c += BLOCKED_COST;
+  }
+  return c;
+}
+
+int dstar_lite::estimate(size_t tile) const {
+  return octile(abs(x_of(tile) - x_of(_start)),
+                abs(y_of(tile) - y_of(_start)));
+}
+
+dstar_lite::priority_t dstar_lite::calculate_key(int g, int rhs,
+                                                 size_t tile) const {
+  int m = min(g, rhs);
+  if (m >= INF) {
+    return priority_t(INF, INF);
+  }
+  return priority_t(m + estimate(tile) + _km, m);
+}
+
+void dstar_lite::update_tile(size_t tile) {
+  int x = x_of(tile);
+  int y = y_of(tile);
+  int rhs = INF;
+  if (binary_search(_targets.begin(), _targets.end(), tile)) {
+    rhs = 0;
+  } else if (is_walkable(tile)) {
+    for (int dir = 0; dir < 9; ++dir) {
+      int x1 = x + dir % 3 - 1;
+      int y1 = y + dir / 3 - 1;
+      if (dir == 4 || x1 < 0 || x1 >= _w || y1 < 0 || y1 >= _h) {
+        continue;
+      }
+      size_t next = tile_at(x1, y1);
+      if (g(next) >= INF || !is_walkable(next)) {
+        continue;
+      }
+      rhs = min(rhs, cost(tile, next) + g(next));
+    }
+  }
+  const node_t& current = _nodes(x, y);
+  if (rhs >= INF && current.g >= INF && !current.is_open) {
+    return; // the search never reached it, don't store it
+  }
+  node_t& n = node(tile);
+  n.rhs = rhs;
+  n.is_open = n.g != n.rhs;
+  if (n.is_open) {
+    n.key = calculate_key(n.g, n.rhs, tile);
+    _open.push_back(make_pair(n.key, tile));
+    push_heap(_open.begin(), _open.end(), greater<entry_t>());
+  }
+}
+
+void dstar_lite::update_neighbors(size_t tile) {
+  int x = x_of(tile);
+  int y = y_of(tile);
+  for (int dir = 0; dir < 9; ++dir) {
+    int x1 = x + dir % 3 - 1;
+    int y1 = y + dir / 3 - 1;
+    if (dir != 4 && x1 >= 0 && x1 < _w && y1 >= 0 && y1 < _h) {
+      update_tile(tile_at(x1, y1));
+    }
+  }
+}
+
+void dstar_lite::compute() {
+  while (!_open.empty()) {
+    entry_t top = _open.front();
+    node_t& u = node(top.second);
+    if (!u.is_open || u.key != top.first) {
+      pop_heap(_open.begin(), _open.end(), greater<entry_t>());
+      _open.pop_back();
+      continue;
+    }
+    // done once nothing left can lower the cost of the start
+    const node_t& s = _nodes(x_of(_start), y_of(_start));
+    if (top.first >= calculate_key(s.g, s.rhs, _start) && s.g == s.rhs) {
+      break;
+    }
+    pop_heap(_open.begin(), _open.end(), greater<entry_t>());
+    _open.pop_back();
+    ++_expanded;
+
+    priority_t key = calculate_key(u.g, u.rhs, top.second);
+    if (top.first < key) {
+      // queued before the start moved
+      u.key = key;
+      _open.push_back(make_pair(key, top.second));
+      push_heap(_open.begin(), _open.end(), greater<entry_t>());
+    } else if (u.g > u.rhs) {
+      u.g = u.rhs;
+      u.is_open = false;
+      update_neighbors(top.second);
+    } else {
+      // got more expensive, its neighbors may have to find another way
+      u.g = INF;
+      u.is_open = false;
+      update_tile(top.second);
+      update_neighbors(top.second);
+    }
+  }
+}
+
+void dstar_lite::compact() {
+  _km = 0;
+  vector<entry_t> open;
+  for (size_t i = 0; i < _open.size(); ++i) {
+    node_t& n = node(_open[i].second);
+    if (n.is_open && n.key == _open[i].first) {
+      n.key = calculate_key(n.g, n.rhs, _open[i].second);
+      open.push_back(make_pair(n.key, _open[i].second));
+    }
+  }
+  make_heap(open.begin(), open.end(), greater<entry_t>());
+  _open.swap(open);
+  _compact_size = max(MIN_OPEN, _open.size() * 2);
+}
+
+size_t dstar_lite::first_step() const {
+  if (g(_start) == 0 || g(_start) >= INF) {
+    return NO_TILE;
+  }
+  int x = x_of(_start);
+  int y = y_of(_start);
+  size_t best = NO_TILE;
+  int best_cost = INF;
+  for (int dir = 0; dir < 9; ++dir) {
+    int x1 = x + dir % 3 - 1;
+    int y1 = y + dir / 3 - 1;
+    if (dir == 4 || x1 < 0 || x1 >= _w || y1 < 0 || y1 >= _h) {
+      continue;
+    }
+    size_t next = tile_at(x1, y1);
+    if (g(next) >= INF || !is_walkable(next)) {
+      continue;
+    }
+    int c = cost(_start, next) + g(next);
+    if (c < best_cost) {
+      best = next;
+      best_cost = c;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,97 @@
+#ifndef DSTAR_HPP
+#define DSTAR_HPP
+
+#include <climits>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "chunked_grid.hpp"
+#include "pathfinding.hpp"
+
+// incremental search from the closest of several targets back to a start
+// (D* Lite), it keeps its search tree between updates and only repairs the
+// part that changed:
+// - the start moving only shrinks the estimates, which is made up for by
+//   adding to every key (km) instead of queueing everything again, so it
+//   can be shared by everyone moving towards the same targets
+// - targets that moved, tiles edited and tiles taken or left by characters
+//   repair the costs around them
+// characters in the way cost a detour instead of being walls, so a way past
+// them is kept while they move around and is only cut by the walls
+class dstar_lite {
+public:
+  dstar_lite();
+
+  // repairs the search after the start, the targets, the characters in the
+  // way or the map changed and searches until the cost of the start is
+  // known, a map of another size or a map version missed by tile_changed
+  // starts over
+  void update(int w, int h, const passable_t& walkable,
+              const std::vector<pos_t>& blocked,
+              const std::vector<pos_t>& targets, pos_t start,
+              size_t map_version);
+  // the tile was edited, which made the map version map_version
+  void tile_changed(int x, int y, size_t map_version);
+
+  // cost from start to the closest target, -1 if unreachable
+  int dist() const;
+  // first tile of the way to the closest target, false if there is none
+  // (already there or unreachable), it may be blocked if waiting for the
+  // character there costs less than going around
+  bool next_step(pos_t& next) const;
+  // tiles expanded by the last update
+  size_t expanded() const { return _expanded; }
+
+private:
+  static const int INF = INT_MAX / 4; // room to add costs and estimates
+  static const size_t MIN_OPEN = 1024; // open list size before compacting
+  static const int BLOCKED_COST = 8 * STRAIGHT_COST; // to enter a blocked tile
+  static const size_t NO_TILE = size_t(-1);
+
+  // tiles are y * w + x
+  typedef std::pair<int, int> priority_t; // by the first then the second
+  typedef std::pair<priority_t, size_t> entry_t; // (key, tile)
+  typedef struct {
+    int g;
+    int rhs; // one step lookahead of g
+    priority_t key; // in the open list, if is_open
+    bool is_open;
+  } node_t;
+
+  void reset(int w, int h, size_t map_version);
+  size_t tile_at(int x, int y) const { return size_t(y) * _w + x; }
+  int x_of(size_t tile) const { return int(tile % _w); }
+  int y_of(size_t tile) const { return int(tile / _w); }
+  int g(size_t tile) const { return _nodes(x_of(tile), y_of(tile)).g; }
+  node_t& node(size_t tile) { return _nodes.edit(x_of(tile), y_of(tile)); }
+  bool is_walkable(size_t tile) const;
+  int cost(size_t from, size_t to) const; // to neighbor to
+  int estimate(size_t tile) const; // to the start
+  priority_t calculate_key(int g, int rhs, size_t tile) const;
+  void update_tile(size_t tile);
+  void update_neighbors(size_t tile);
+  void compute();
+  // drops the entries of the open list that were queued again since and
+  // computes the keys again without km
+  void compact();
+  // neighbor of the start closest to a target, NO_TILE if none
+  size_t first_step() const;
+
+  int _w;
+  int _h;
+  size_t _map_version;
+  const passable_t* _walkable; // during update
+  bool _is_reset; // nothing searched yet
+  size_t _start;
+  int _km; // estimates shrank by up to this much since the last compact
+  size_t _next; // first step of the way, NO_TILE if none
+  std::vector<size_t> _targets; // sorted
+  std::vector<size_t> _blocked; // sorted
+  std::vector<size_t> _changed; // edited, not repaired yet
+  chunked_grid<node_t> _nodes; // only chunks the search reached
+  std::vector<entry_t> _open; // stale entries are skipped
+  size_t _compact_size; // of the open list, to compact it again
+  size_t _expanded;
+};
+
+#endif // DSTAR_HPP
@@ -0,0 +1,106 @@
+#include "flow_field.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+using namespace std;
+
+flow_field::flow_field() : _w(0), _h(0), _map_version(0) {
+}
+
+bool flow_field::update(int w, int h, const passable_t& passable,
+                        const vector<pos_t>& sources, size_t map_version) {
+  bool same_sources = sources.size() == _sources.size();
+  for (size_t i = 0; same_sources && i < sources.size(); ++i) {
+    same_sources = sources[i].x == _sources[i].x &&
+                   sources[i].y == _sources[i].y;
+  }
+  if (same_sources && w == _w && h == _h && map_version == _map_version &&
+      !_dist.empty()) {
+    return false;
+  }
+  _w = w;
+  _h = h;
+  _map_version = map_version;
+  _sources = sources;
+  _dist.assign(size_t(w) * h, -1);
+  _dir.assign(_dist.size(), -1);
+
+  // multi-source dijkstra, every source starts at distance 0
+  typedef pair<int, size_t> entry_t; // (dist, tile)
+  vector<entry_t> open;
+  for (size_t i = 0; i < sources.size(); ++i) {
+    size_t tile = size_t(sources[i].y) * w + sources[i].x;
+    _dist[tile] = 0;
+    open.push_back(make_pair(0, tile));
+  }
+  make_heap(open.begin(), open.end(), greater<entry_t>());
+  while (!open.empty()) {
+    pop_heap(open.begin(), open.end(), greater<entry_t>());
+    entry_t e = open.back();
+    open.pop_back();
+    size_t tile = e.second;
+    if (e.first > _dist[tile]) {
+      continue;
+    }
+    int x = int(tile % w);
+    int y = int(tile / w);
+    for (int dir = 0; dir < 9; ++dir) {
+      int dx = dir % 3 - 1;
+      int dy = dir / 3 - 1;
+      int x1 = x + dx;
+      int y1 = y + dy;
+      if (dir == 4 || x1 < 0 || x1 >= w || y1 < 0 || y1 >= h ||
+          !passable(x1, y1)) {
+        continue;
+      }
+      size_t next = size_t(y1) * w + x1;
+      int d = e.first + (dx != 0 && dy != 0 ? DIAGONAL_COST : STRAIGHT_COST);
+      if (_dist[next] == -1 || d < _dist[next]) {
+        _dist[next] = d;
+        _dir[next] = 8 - dir; // back towards tile
+        open.push_back(make_pair(d, next));
+        push_heap(open.begin(), open.end(), greater<entry_t>());
+      }
+    }
+  }
+  return true;
+}
+
+int flow_field::dist(int x, int y) const {
+  return _dist[size_t(y) * _w + x];
+}
+
+bool flow_field::next_step(int x, int y, const passable_t& can_enter,
+                           pos_t& next) const {
+  size_t tile = size_t(y) * _w + x;
+  int dir = _dir[tile];
+  if (dir == -1) {
+    return false;
+  }
+  next.x = x + dir % 3 - 1;
+  next.y = y + dir / 3 - 1;
+  if (can_enter(next.x, next.y)) {
+    return true;
+  }
+
+  // best tile is taken, take any other one that still gets closer
+  int best = _dist[tile];
+  bool found = false;
+  for (dir = 0; dir < 9; ++dir) {
+    int x1 = x + dir % 3 - 1;
+    int y1 = y + dir / 3 - 1;
+    if (dir == 4 || x1 < 0 || x1 >= _w || y1 < 0 || y1 >= _h) {
+      continue;
+    }
+    int d = _dist[size_t(y1) * _w + x1];
+    if (d != -1 && d < best && can_enter(x1, y1)) {
+      best = d;
+      next.x = x1;
+      next.y = y1;
+      found = true;
+    }
+  }
+  return found;
+}
@@ -0,0 +1,34 @@
+#ifndef FLOW_FIELD_HPP
+#define FLOW_FIELD_HPP
+
+#include <cstddef>
+#include <vector>
+#include "pathfinding.hpp"
+
+// distance map towards the closest of several sources, shared by everyone
+// moving towards them and computed again whole whenever they move, which
+// only pays off on small maps
+class flow_field {
+public:
+  flow_field();
+
+  // recomputes the distances only if the map version or the sources changed
+  // since the last call, returns true if it did
+  bool update(int w, int h, const passable_t& passable,
+              const std::vector<pos_t>& sources, size_t map_version);
+  // cost to the closest source, -1 if unreachable
+  int dist(int x, int y) const;
+  // neighbor closer to a source that can be entered now, false if there is
+  // none (already next to a source or boxed in)
+  bool next_step(int x, int y, const passable_t& can_enter, pos_t& next) const;
+
+private:
+  int _w;
+  int _h;
+  size_t _map_version;
+  std::vector<pos_t> _sources;
+  std::vector<int> _dist;
+  std::vector<signed char> _dir; // best direction to step (0-8), -1 if none
+};
+
+#endif // FLOW_FIELD_HPP
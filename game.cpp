@@ -1,208 +1,178 @@
 #include "game.hpp"
 
-#include <cmath>
 #include <cstdio>
-#include <cstring>
+#include <cstdlib>
 #include "ai.hpp"
-#include "device.hpp"
-#include "material.hpp"
+#include "ai_state.hpp"
+#include "map_file.hpp"
+#include "tokenizer.hpp"
 
 using namespace std;
 
-const char* DELIM = ", \t";
-
-Game::Game(Device& dev, const string& mat_file, const string& map_file,
-           const string& ch_file, const string& en_file) {
-  FILE* f;
-  char buffer[1024];
+// characters and enemies have the same fields, enemies have no position
+void read_character(tokenizer& t, const image_loader_t& load_image,
+                    bool has_position, character& ch) {
+  ch.name = t.read_string();
+  ch.image = load_image(t.read_string());
+  ch.is_playable = t.read_int();
+  ch.base_start = t.read_int();
+  ch.base_size = t.read_int();
+  if (has_position) {
+    ch.pos.x = t.read_int();
+    ch.pos.y = t.read_int();
+  }
+  ch.hp = t.read_int();
+  ch.hp_max = t.read_int();
+  ch.armor_class = t.read_int();
+  ch.stats.strength = t.read_int();
+  ch.stats.dexterity = t.read_int();
+  ch.stats.constitution = t.read_int();
+  ch.stats.intelligence = t.read_int();
+  ch.stats.wisdom = t.read_int();
+  ch.stats.charisma = t.read_int();
+  ch.move_limit = t.read_int();
+  ch.attack_bonus = t.read_int();
+  ch.critical = t.read_int();
+  ch.range = t.read_int();
+  ch.ammo = t.read_int();
+  ch.damage = t.read_int();
+}
 
-  material mat;
-  puts("Reading materials");
-  f = fopen(mat_file.c_str(), "r");
-  if (f == NULL) {
-    fprintf(stderr, "Error opening file: %s\n", mat_file.c_str());
+void open_asset(tokenizer& t, const string& file) {
+  if (!t.open(file)) {
+    fprintf(stderr, "Error opening file: %s\n", file.c_str());
     exit(EXIT_FAILURE);
   }
-  while (fgets(buffer, sizeof(buffer), f) != NULL) {
-    if (buffer[0] == '#') { // comment
-      continue;
-    }
-    mat.name = strtok(buffer, DELIM);
-    mat.image = dev.load_image(strtok(NULL, DELIM));
-    mat.pos_x = atoi(strtok(NULL, DELIM));
-    mat.pos_y = atoi(strtok(NULL, DELIM));
-    mat.n_x = atoi(strtok(NULL, DELIM));
-    mat.n_y = atoi(strtok(NULL, DELIM));
-    mat.is_walkable = atoi(strtok(NULL, DELIM));
-    materials.push_back(mat);
+}
+
+Game::Game(const image_loader_t& load_image, const string& mat_file,
+           const string& map_file, const string& ch_file,
+           const string& en_file, uint64_t rng_seed) {
+  map_version = 0;
+  enemy_count = 0;
+  seed = rng_seed;
+  dice.reseed(seed);
+  ai.reset(new ai_store);
+  tokenizer t;
+
+  puts("Reading materials");
+  materials = read_materials(mat_file, load_image);
+  for (size_t i = 0; i < 256; ++i) {
+    tile_walkable[i] = i < materials.size() && materials[i].is_walkable;
   }
-  fclose(f);
 
   load_map(map_file);
 
   puts("Reading characters");
   character ch;
-  f = fopen(ch_file.c_str(), "r");
-  if (f == NULL) {
-    fprintf(stderr, "Error opening file: %s\n", ch_file.c_str());
-    exit(EXIT_FAILURE);
+  ch.ai = NO_AI;
+  open_asset(t, ch_file);
+  while (t.next_line()) {
+    read_character(t, load_image, true, ch);
+    turns.insert(characters.insert(ch), roll_initiative(ch));
   }
-  while (fgets(buffer, sizeof(buffer), f) != NULL) {
-    if (buffer[0] == '#') { // comment
-      continue;
-    }
-    ch.name = strtok(buffer, DELIM);
-    ch.image = dev.load_image(strtok(NULL, DELIM));
-    ch.is_playable = atoi(strtok(NULL, DELIM));
-    ch.base_start = atof(strtok(NULL, DELIM));
-    ch.base_size = atoi(strtok(NULL, DELIM));
-    ch.pos.x = atoi(strtok(NULL, DELIM));
-    ch.pos.y = atoi(strtok(NULL, DELIM));
-    ch.hp = atoi(strtok(NULL, DELIM));
-    ch.hp_max = atoi(strtok(NULL, DELIM));
-    ch.armor_class = atoi(strtok(NULL, DELIM));
-    ch.stats.strength = atoi(strtok(NULL, DELIM));
-    ch.stats.dexterity = atoi(strtok(NULL, DELIM));
-    ch.stats.constitution = atoi(strtok(NULL, DELIM));
-    ch.stats.intelligence = atoi(strtok(NULL, DELIM));
-    ch.stats.wisdom = atoi(strtok(NULL, DELIM));
-    ch.stats.charisma = atoi(strtok(NULL, DELIM));
-    ch.move_limit = atoi(strtok(NULL, DELIM));
-    ch.attack_bonus = atoi(strtok(NULL, DELIM));
-    ch.critical = atoi(strtok(NULL, DELIM));
-    ch.range = atoi(strtok(NULL, DELIM));
-    ch.ammo = atoi(strtok(NULL, DELIM));
-    ch.damage = atoi(strtok(NULL, DELIM));
-    characters.push_back(ch);
-  }
-  fclose(f);
 
-  // populate turns
-  turns.resize(characters.size());
-  for (size_t i = 0; i < turns.size(); ++i) {
-    turns[i] = i;
-  }
+  update_occupancy();
 
-  focus_x = characters[turns[0]].pos.x;
-  focus_y = characters[turns[0]].pos.y;
-  move_limit = characters[turns[0]].move_limit;
+  focus_x = characters[turns.current()].pos.x;
+  focus_y = characters[turns.current()].pos.y;
+  move_limit = characters[turns.current()].move_limit;
   diag_moves = 0;
+  turn = 0;
 
   puts("Reading enemies");
-  f = fopen(en_file.c_str(), "r");
-  if (f == NULL) {
-    fprintf(stderr, "Error opening file: %s\n", en_file.c_str());
-    exit(EXIT_FAILURE);
-  }
-  while (fgets(buffer, sizeof(buffer), f) != NULL) {
-    if (buffer[0] == '#') { // comment
-      continue;
-    }
-    ch.name = strtok(buffer, DELIM);
-    ch.image = dev.load_image(strtok(NULL, DELIM));
-    ch.is_playable = atoi(strtok(NULL, DELIM));
-    ch.base_start = atof(strtok(NULL, DELIM));
-    ch.base_size = atoi(strtok(NULL, DELIM));
-    ch.hp = atoi(strtok(NULL, DELIM));
-    ch.hp_max = atoi(strtok(NULL, DELIM));
-    ch.armor_class = atoi(strtok(NULL, DELIM));
-    ch.stats.strength = atoi(strtok(NULL, DELIM));
-    ch.stats.dexterity = atoi(strtok(NULL, DELIM));
-    ch.stats.constitution = atoi(strtok(NULL, DELIM));
-    ch.stats.intelligence = atoi(strtok(NULL, DELIM));
-    ch.stats.wisdom = atoi(strtok(NULL, DELIM));
-    ch.stats.charisma = atoi(strtok(NULL, DELIM));
-    ch.move_limit = atoi(strtok(NULL, DELIM));
-    ch.attack_bonus = atoi(strtok(NULL, DELIM));
-    ch.critical = atoi(strtok(NULL, DELIM));
-    ch.range = atoi(strtok(NULL, DELIM));
-    ch.ammo = atoi(strtok(NULL, DELIM));
-    ch.damage = atoi(strtok(NULL, DELIM));
+  open_asset(t, en_file);
+  while (t.next_line()) {
+    read_character(t, load_image, false, ch);
     enemies.push_back(ch);
   }
-  fclose(f);
 }
 
-void Game::load_map(const string& file) {
-  char buffer[1024];
-  char* tok;
+// defined here, where ai_store is complete
+Game::~Game() {
+}
 
+void Game::load_map(const string& file) {
   puts("Reading map");
-  FILE* f = fopen(file.c_str(), "r");
-  if (f == NULL) {
-    fprintf(stderr, "Error opening file: %s\n", file.c_str());
+  if (!map.load(file, materials)) {
     return;
   }
-  // read first row and determine number of columns
-  fgets(buffer, sizeof(buffer), f);
-  map.resize(1);
-  map[0].resize(0);
-  tok = strtok(buffer, DELIM);
-  while (tok != NULL) {
-    map[0].push_back(atoi(tok));
-    tok = strtok(NULL, DELIM);
-  }
+  ++map_version;
+  update_occupancy();
+}
 
-  // read rest of map, incomplete information will be filled with material 0
-  while (fgets(buffer, sizeof(buffer), f) != NULL) {
-    map.resize(map.size() + 1);
-    map.back().resize(map[0].size());
-    tok = strtok(buffer, DELIM);
-    for (size_t i = 0; i < map[0].size() && tok != NULL; ++i) {
-      map.back()[i] = atoi(tok);
-      tok = strtok(NULL, DELIM);
-    }
+void Game::set_tile(int x, int y, tile_t material) {
+  if (!map.contains(x, y)) {
+    return;
   }
-  fclose(f);
+  map.set(x, y, material);
+  ++map_version;
+  ai_tile_changed(*this, x, y);
+}
+
+int Game::roll_initiative(const character& ch) {
+  return dice.roll(20) + 1 + ch.stats.dexterity / 2 - 5;
 }
 
 character Game::generate_enemy(size_t enemy_idx, int x, int y) {
-  static int count = 0;
   character ch;
   ch = enemies[enemy_idx];
-  ch.name += to_string(++count);
+  ch.name += to_string(++enemy_count);
   ch.pos.x = x;
   ch.pos.y = y;
   return ch;
 }
 
-size_t Game::create_enemy(size_t enemy_idx, int x, int y) {
-  size_t idx = characters.size();
-  turns.push_back(idx);
-  characters.push_back(generate_enemy(enemy_idx, x, y));
-  create_character_ai(*this, idx);
-  return idx;
+character_handle Game::create_enemy(size_t enemy_idx, int x, int y) {
+  character_handle ch = characters.insert(generate_enemy(enemy_idx, x, y));
+  turns.insert(ch, roll_initiative(characters[ch]));
+  occupy(characters[ch], ch);
+  nearby.insert(ch, x, y);
+  create_character_ai(*this, ch);
+  return ch;
 }
 
-void Game::delete_character(size_t idx) {
-  delete_character_ai(*this, idx);
-  characters.erase(characters.begin() + idx);
-  for (size_t i = 0; i < turns.size(); ++i) {
-    if (turns[i] == idx) {
-      turns.erase(turns.begin() + i);
-    }
-  }
-  for (size_t i = 0; i < turns.size(); ++i) {
-    if (turns[i] > idx) {
-      --turns[i];
-    }
-  }
+void Game::delete_character(character_handle ch) {
+  delete_character_ai(*this, ch);
+  occupy(characters[ch], NO_HANDLE);
+  nearby.erase(ch, characters[ch].pos.x, characters[ch].pos.y);
+  characters.erase(ch);
+  turns.erase(ch);
 }
 
-bool Game::is_tile_occupied(int x, int y) {
+void Game::place_character(character_handle ch, int x, int y) {
+  position& pos = characters[ch].pos;
+  occupy(characters[ch], NO_HANDLE);
+  nearby.move(ch, pos.x, pos.y, x, y);
+  pos.x = x;
+  pos.y = y;
+  occupy(characters[ch], ch);
+}
+
+void Game::update_occupancy() {
+  occupancy.assign(map.width(), map.height(), NO_HANDLE);
+  nearby.assign(map.width(), map.height());
   for (size_t i = 0; i < characters.size(); ++i) {
-    const character& ch = characters[i];
-    if (ch.pos.x == x && ch.pos.y == y) {
-      return true;
+    const character& ch = characters.dense(i);
+    occupy(ch, characters.handle_at(i));
+    nearby.insert(characters.handle_at(i), ch.pos.x, ch.pos.y);
+  }
+}
+
+void Game::occupy(const character& ch, character_handle value) {
+  for (int y = ch.pos.y; y < ch.pos.y + ch.base_size; ++y) {
+    for (int x = ch.pos.x; x < ch.pos.x + ch.base_size; ++x) {
+      if (occupancy.contains(x, y)) {
+        occupancy.edit(x, y) = value;
+      }
     }
   }
-  return false;
 }
 
 void Game::set_focus() {
   const int DIST = 1;
-  int x = characters[turns[0]].pos.x;
-  int y = characters[turns[0]].pos.y;
+  int x = characters[turns.current()].pos.x;
+  int y = characters[turns.current()].pos.y;
 
   if (x - focus_x > DIST) {
     focus_x = x - DIST;
@@ -218,40 +188,52 @@ void Game::set_focus() {
 }
 
 void Game::end_turn() {
-  size_t temp = turns[0];
-  memmove(&turns[0], &turns[1], (turns.size() - 1) * sizeof(turns[0]));
-  turns.back() = temp;
-  focus_x = characters[turns[0]].pos.x;
-  focus_y = characters[turns[0]].pos.y;
-  move_limit = characters[turns[0]].move_limit;
+  turns.advance();
+  ++turn;
+  focus_x = characters[turns.current()].pos.x;
+  focus_y = characters[turns.current()].pos.y;
+  move_limit = characters[turns.current()].move_limit;
   diag_moves = 0;
 }
 
 bool Game::can_move(int dx, int dy, bool obstacles) {
-  character& ch = characters[turns[0]];
-  int x0 = ch.pos.x;
-  int y0 = ch.pos.y;
-  int x1 = x0 + dx;
-  int y1 = y0 + dy;
+  character& ch = characters[turns.current()];
+  int x1 = ch.pos.x + dx;
+  int y1 = ch.pos.y + dy;
+  int size = ch.base_size;
   if (x1 < 0 ||
-      x1 >= int(map[0].size()) ||
-      y1 >= int(map.size()) ||
-      y1 < 0 ||
-      (obstacles && !materials[map[y1][x1]].is_walkable) ||
-      (obstacles && is_tile_occupied(x1, y1))) {
+      x1 + size > map.width() ||
+      y1 + size > map.height() ||
+      y1 < 0) {
     return false;
   }
+  if (!obstacles) {
+    return true;
+  }
+  if (dx == 0 && dy == 0) {
+    return false;
+  }
+  // every tile under the character's base must be free, except for the ones
+  // it is already standing on
+  character_handle self = turns.current();
+  for (int y = y1; y < y1 + size; ++y) {
+    for (int x = x1; x < x1 + size; ++x) {
+      if (!is_walkable(x, y) || (occupancy(x, y) != NO_HANDLE &&
+                                 occupancy(x, y) != self)) {
+        return false;
+      }
+    }
+  }
   return true;
 }
 
 bool Game::move(int dx, int dy) {
-  character& ch = characters[turns[0]];
+  character& ch = characters[turns.current()];
   if (!can_move(dx, dy, true)) {
     return false;
   }
   if (move_limit < 0) {
-    ch.pos.x += dx;
-    ch.pos.y += dy;
+    place_character(turns.current(), ch.pos.x + dx, ch.pos.y + dy);
     set_focus();
     return true;
   } else {
@@ -263,50 +245,48 @@ bool Game::move(int dx, int dy) {
       ++diag_moves;
     }
     move_limit -= moves;
-    ch.pos.x += dx;
-    ch.pos.y += dy;
+    place_character(turns.current(), ch.pos.x + dx, ch.pos.y + dy);
     set_focus();
   }
   return true;
 }
 
-vector<size_t> Game::attack_range() {
-  vector<size_t> list;
-  const character& ch1 = characters[turns[0]];
-  for (size_t i = 0; i < characters.size(); ++i) {
+vector<character_handle> Game::attack_range() {
+  vector<character_handle> list;
+  const character& ch1 = characters[turns.current()];
+  vector<character_handle> candidates;
+  nearby.query(ch1.pos.x, ch1.pos.y, ch1.range, candidates);
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    character_handle target = candidates[i];
     // ignore self
-    if (i == turns[0]) {
+    if (target == turns.current()) {
       continue;
     }
-    const character& ch2 = characters[i];
+    const character& ch2 = characters[target];
     // no friendly fire
     if (ch1.is_playable == ch2.is_playable) {
       continue;
     }
 
-    double dist_x = abs(double(ch1.pos.x) - ch2.pos.x);
-    double dist_y = abs(double(ch1.pos.y) - ch2.pos.y);
-    int dist = pow(dist_x * dist_x + dist_y * dist_y, 0.5) + 0.5;
-    if (dist <= ch1.range) {
-      list.push_back(i);
+    if (in_range(ch2.pos.x - ch1.pos.x, ch2.pos.y - ch1.pos.y, ch1.range)) {
+      list.push_back(target);
     }
   }
   return list;
 }
 
-void Game::attack(size_t idx) {
-  const character& ch1 = characters[turns[0]];
-  character& ch2 = characters[idx];
+void Game::attack(character_handle target) {
+  const character& ch1 = characters[turns.current()];
+  character& ch2 = characters[target];
   int att_mod = 1;
   if (ch1.stats.strength > 18) {
     att_mod = 4;
   }
-  srand(clock());
-  if (rand() % 20 + ch1.attack_bonus < ch2.armor_class) {
+  if (dice.roll(20) + ch1.attack_bonus < ch2.armor_class) {
     printf("%s's attack missed\n", ch1.name.c_str());
     return;
   }
-  int damage = rand() % ch1.damage + att_mod;
+  int damage = dice.roll(ch1.damage) + att_mod;
   ch2.hp -= damage;
   printf("%s attacked %s for %d damage\n", ch1.name.c_str(), ch2.name.c_str(),
          damage);
@@ -314,6 +294,6 @@ void Game::attack(size_t idx) {
   // if character attacked has no more HP, remove it
   if (ch2.hp <= 0) {
     printf("%s died\n", ch2.name.c_str());
-    delete_character(idx);
+    delete_character(target);
   }
 }
@@ -1,11 +1,24 @@
 #ifndef GAME_HPP
 #define GAME_HPP
 
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 #include "character.hpp"
+#include "chunked_grid.hpp"
+#include "map_file.hpp"
 #include "material.hpp"
+#include "pathfinding.hpp"
+#include "rng.hpp"
+#include "slot_map.hpp"
+#include "spatial_hash.hpp"
+#include "turn_order.hpp"
+#include "world_map.hpp"
 
-class Device;
+class ai_store;
+
+typedef slot_handle character_handle;
 
 class Game {
 public:
@@ -13,25 +26,51 @@ public:
   int focus_y;
   int move_limit;
   int diag_moves;
+  size_t turn; // turns played so far
+  size_t map_version; // changes every time a tile changes
   std::vector<material> materials;
-  std::vector<std::vector<size_t> > map;
-  std::vector<character> characters;
-  std::vector<size_t> turns;
+  bool tile_walkable[256]; // by material, TILE_NONE is never walkable
+  world_map map; // TILE_NONE outside
+  slot_map<character> characters;
+  // the character on every tile it covers, NO_HANDLE if none
+  chunked_grid<character_handle> occupancy;
+  spatial_hash nearby; // characters by position, for range queries
+  turn_order turns;
   std::vector<character> enemies;
+  int enemy_count; // enemies generated so far, to number their names
+  uint64_t seed; // the same seed and inputs replay the same game
+  rng dice; // every random decision of the game
+  std::unique_ptr<ai_store> ai;
+
 
-  Game(Device& dev, const std::string& mat_file, const std::string& map_file,
-       const std::string& ch_file, const std::string& en_file);
+  Game(const image_loader_t& load_image, const std::string& mat_file,
+       const std::string& map_file, const std::string& ch_file,
+       const std::string& en_file, uint64_t rng_seed);
+  ~Game();
   void load_map(const std::string& file);
+  void set_tile(int x, int y, tile_t material);
+  bool is_walkable(int x, int y) const { return tile_walkable[map(x, y)]; }
+  // d20 plus the dexterity modifier
+  int roll_initiative(const character& ch);
   character generate_enemy(size_t enemy_idx, int x, int y);
-  size_t create_enemy(size_t enemy_idx, int x, int y);
-  void delete_character(size_t idx);
-  bool is_tile_occupied(int x, int y);
+  character_handle create_enemy(size_t enemy_idx, int x, int y);
+  void delete_character(character_handle ch);
+  void place_character(character_handle ch, int x, int y);
+  void update_occupancy();
+  bool is_tile_occupied(int x, int y) const {
+    return occupancy(x, y) != NO_HANDLE;
+  }
+  // the character covering a tile, NO_HANDLE if none
+  character_handle character_at(int x, int y) const { return occupancy(x, y); }
   void set_focus();
   void end_turn();
   bool can_move(int dx, int dy, bool obstacles = true);
   bool move(int dx, int dy);
-  std::vector<size_t> attack_range();
-  void attack(size_t i);
+  std::vector<character_handle> attack_range();
+  void attack(character_handle target);
+
+private:
+  void occupy(const character& ch, character_handle value);
 };
 
 #endif // GAME_HPP
@@ -0,0 +1,67 @@
+#ifndef GRID_HPP
+#define GRID_HPP
+
+#include <cstddef>
+#include <vector>
+
+// 2D grid stored contiguously row by row, surrounded by a one cell border so
+// the 8 neighbors of any cell can be read without bounds checks
+template <class T>
+class grid {
+public:
+  grid() : _w(0), _h(0), _stride(2) {}
+  grid(int w, int h, const T& value = T(), const T& border = T()) {
+    assign(w, h, value, border);
+  }
+
+  void assign(int w, int h, const T& value = T(), const T& border = T()) {
+    _w = w;
+    _h = h;
+    _stride = w + 2;
+    _cells.assign(size_t(_stride) * (h + 2), border);
+    for (int y = 0; y < h; ++y) {
+      for (int x = 0; x < w; ++x) {
+        (*this)(x, y) = value;
+      }
+    }
+  }
+
+  // sets every cell inside the grid, the border is left untouched
+  void fill(const T& value) {
+    for (int y = 0; y < _h; ++y) {
+      for (int x = 0; x < _w; ++x) {
+        (*this)(x, y) = value;
+      }
+    }
+  }
+
+  int width() const { return _w; }
+  int height() const { return _h; }
+  bool empty() const { return _w == 0 || _h == 0; }
+  bool contains(int x, int y) const {
+    return x >= 0 && x < _w && y >= 0 && y < _h;
+  }
+
+  // x and y can be -1 or width/height to read the border
+  T& operator()(int x, int y) { return _cells[index(x, y)]; }
+  const T& operator()(int x, int y) const { return _cells[index(x, y)]; }
+
+  // linear access, a neighbor is at index + dy * stride() + dx
+  int stride() const { return _stride; }
+  size_t size() const { return _cells.size(); }
+  size_t index(int x, int y) const { return size_t(y + 1) * _stride + x + 1; }
+  int x_of(size_t index) const { return int(index % _stride) - 1; }
+  int y_of(size_t index) const { return int(index / _stride) - 1; }
+  T& operator[](size_t index) { return _cells[index]; }
+  const T& operator[](size_t index) const { return _cells[index]; }
+  T* data() { return _cells.data(); }
+  const T* data() const { return _cells.data(); }
+
+private:
+  int _w;
+  int _h;
+  int _stride;
+  std::vector<T> _cells;
+};
+
+#endif // GRID_HPP
@@ -0,0 +1,416 @@
+#include "hpa.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <unordered_map>
+
+using namespace std;
+
+const int hpa_finder::CLUSTER_TILES;
+const int hpa_finder::MAX_ENTRANCE;
+const size_t hpa_finder::NO_TILE;
+
+const int CLUSTER_AREA = hpa_finder::CLUSTER_TILES * hpa_finder::CLUSTER_TILES;
+const size_t GOAL = size_t(-1); // abstract node of dest, never a tile
+
+hpa_finder::hpa_finder() : _w(0), _h(0), _cols(0), _rows(0), _map_version(0),
+                           _local(CLUSTER_AREA), _parent(CLUSTER_AREA),
+                           _expanded(0) {
+}
+
+void hpa_finder::update(int w, int h, const passable_t& walkable,
+                        size_t map_version) {
+  if (w != _w || h != _h || map_version != _map_version ||
+      _clusters.empty()) {
+    _w = w;
+    _h = h;
+    _cols = (w + CLUSTER_TILES - 1) / CLUSTER_TILES;
+    _rows = (h + CLUSTER_TILES - 1) / CLUSTER_TILES;
+    _map_version = map_version;
+    size_t clusters = size_t(_cols) * _rows;
+    _right.assign(clusters, vector<transition_t>());
+    _down.assign(clusters, vector<transition_t>());
+    _clusters.assign(clusters, cluster_t());
+    _is_dirty.assign(clusters, false);
+    _dirty.clear();
+    for (int c = 0; c < int(clusters); ++c) {
+      build_border(c, true, walkable);
+      build_border(c, false, walkable);
+    }
+    for (int c = 0; c < int(clusters); ++c) {
+      build_cluster(c, walkable);
+    }
+    return;
+  }
+  if (_dirty.empty()) {
+    return;
+  }
+
+  // a tile only changes the borders of its cluster, the entrances of its
+  // four neighbors come from those borders too
+  vector<int> changed;
+  for (size_t i = 0; i < _dirty.size(); ++i) {
+    int c = _dirty[i];
+    build_border(c, true, walkable);
+    build_border(c, false, walkable);
+    if (c % _cols > 0) {
+      build_border(c - 1, true, walkable);
+    }
+    if (c / _cols > 0) {
+      build_border(c - _cols, false, walkable);
+    }
+    changed.push_back(c);
+    if (c % _cols > 0) {
+      changed.push_back(c - 1);
+    }
+    if (c % _cols < _cols - 1) {
+      changed.push_back(c + 1);
+    }
+    if (c / _cols > 0) {
+      changed.push_back(c - _cols);
+    }
+    if (c / _cols < _rows - 1) {
+      changed.push_back(c + _cols);
+    }
+    _is_dirty[c] = false;
+  }
+  _dirty.clear();
+  sort(changed.begin(), changed.end());
+  changed.erase(unique(changed.begin(), changed.end()), changed.end());
+  for (size_t i = 0; i < changed.size(); ++i) {
+    build_cluster(changed[i], walkable);
+  }
+}
+
+void hpa_finder::tile_changed(int x, int y, size_t map_version) {
+  // changes missed before this one mean a full rebuild anyway
+  if (_clusters.empty() || map_version != _map_version + 1 ||
+      x < 0 || x >= _w || y < 0 || y >= _h) {
+    return;
+  }
+  _map_version = map_version;
+  int c = cluster_of(x, y);
+  if (!_is_dirty[c]) {
+    _is_dirty[c] = true;
+    _dirty.push_back(c);
+  }
+}
+
+bool hpa_finder::find(const passable_t& walkable, const passable_t& can_enter,
+                      pos_t start, pos_t dest, int range,
+                      deque<pos_t>& path) {
+  _expanded = 0;
+  path.clear();
+  if (start.x < 0 || start.x >= _w || start.y < 0 || start.y >= _h ||
+      dest.x < 0 || dest.x >= _w || dest.y < 0 || dest.y >= _h) {
+    return false;
+  }
+  if (abs(start.x - dest.x) <= range && abs(start.y - dest.y) <= range) {
+    return true;
+  }
+  size_t s = tile_at(start.x, start.y);
+  int sc = cluster_of(start.x, start.y);
+  int dc = cluster_of(dest.x, dest.y);
+  if (sc == dc) {
+    // most short paths never leave the cluster
+    size_t tile = search_cluster(sc, s, can_enter, dest, range);
+    if (tile != NO_TILE) {
+      append_path(sc, tile, path);
+      return true;
+    }
+  }
+
+  // start and dest join the entrances of their clusters for this query
+  pos_t none = {0, 0};
+  search_cluster(sc, s, walkable, none, -1);
+  vector<int> start_dist(_local);
+  search_cluster(dc, tile_at(dest.x, dest.y), walkable, none, -1);
+  vector<int> goal_dist(_local);
+
+  // A* over the entrances, by tile
+  unordered_map<size_t, int> g;
+  unordered_map<size_t, size_t> parent;
+  vector<entry_t> open;
+  // lowest f first, then the goal, which wraps around to 0, then the lowest
+  // tile
+  auto later = [](const entry_t& a, const entry_t& b) {
+    return a.first != b.first ? a.first > b.first
+                              : a.second + 1 > b.second + 1;
+  };
+  auto estimate = [&](size_t tile) {
+    return octile(abs(x_of(tile) - dest.x), abs(y_of(tile) - dest.y));
+  };
+  auto relax = [&](size_t tile, int cost, size_t from) {
+    unordered_map<size_t, int>::iterator it = g.find(tile);
+    if (it != g.end() && it->second <= cost) {
+      return;
+    }
+    g[tile] = cost;
+    parent[tile] = from;
+    open.push_back(make_pair(cost + (tile == GOAL ? 0 : estimate(tile)), tile));
+    push_heap(open.begin(), open.end(), later);
+  };
+  relax(s, 0, s);
+  bool found = false;
+  while (!open.empty()) {
+    pop_heap(open.begin(), open.end(), later);
+    entry_t e = open.back();
+    open.pop_back();
+    size_t tile = e.second;
+    if (tile == GOAL) {
+      found = true;
+      break;
+    }
+    int cost = g[tile];
+    if (e.first > cost + estimate(tile)) {
+      continue; // stale
+    }
+    ++_expanded;
+
+    int c = cluster_of(tile);
+    const cluster_t& cl = _clusters[c];
+    int n = int(cl.nodes.size());
+    int i = node_of(cl, tile);
+    for (int j = 0; j < n; ++j) {
+      int d = tile == s ? start_dist[local_of(c, cl.nodes[j])]
+                        : i == -1 ? -1 : cl.dist[i * n + j];
+      if (d > 0) {
+        relax(cl.nodes[j], cost + d, tile);
+      }
+    }
+    if (i != -1) {
+      for (size_t j = 0; j < cl.links[i].size(); ++j) {
+        relax(cl.links[i][j], cost + STRAIGHT_COST, tile);
+      }
+    }
+    if (c == dc && goal_dist[local_of(c, tile)] >= 0) {
+      relax(GOAL, cost + goal_dist[local_of(c, tile)], tile);
+    }
+  }
+  if (!found) {
+    return false;
+  }
+
+  // refines every hop over the abstract path, entrances next to each other
+  // are one step apart
+  vector<size_t> hops;
+  for (size_t tile = GOAL; tile != s; tile = parent[tile]) {
+    hops.push_back(tile);
+  }
+  size_t from = s;
+  for (size_t i = hops.size(); i-- > 0;) {
+    size_t to = hops[i];
+    int c = cluster_of(from);
+    if (to == GOAL) {
+      size_t tile = search_cluster(c, from, can_enter, dest, range);
+      if (tile == NO_TILE) {
+        path.clear();
+        return false;
+      }
+      append_path(c, tile, path);
+      break;
+    }
+    pos_t p = {x_of(to), y_of(to)};
+    if (cluster_of(to) != c) {
+      if (!can_enter(p.x, p.y)) {
+        path.clear();
+        return false;
+      }
+      path.push_back(p);
+    } else if (search_cluster(c, from, can_enter, p, 0) == to) {
+      append_path(c, to, path);
+    } else {
+      path.clear();
+      return false;
+    }
+    from = to;
+  }
+
+  // the way to the entrances may pass within range already
+  for (size_t i = 0; i < path.size(); ++i) {
+    if (abs(path[i].x - dest.x) <= range && abs(path[i].y - dest.y) <= range) {
+      path.erase(path.begin() + i + 1, path.end());
+      break;
+    }
+  }
+  return true;
+}
+
+size_t hpa_finder::nodes() const {
+  size_t n = 0;
+  for (size_t i = 0; i < _clusters.size(); ++i) {
+    n += _clusters[i].nodes.size();
+  }
+  return n;
+}
+
+int hpa_finder::cluster_of(size_t tile) const {
+  return cluster_of(x_of(tile), y_of(tile));
+}
+
+int hpa_finder::node_of(const cluster_t& c, size_t tile) const {
+  vector<size_t>::const_iterator it = std::find(c.nodes.begin(),
+                                                c.nodes.end(), tile);
+  return it == c.nodes.end() ? -1 : int(it - c.nodes.begin());
+}
+
+int hpa_finder::local_of(int c, size_t tile) const {
+  int x = x_of(tile) - c % _cols * CLUSTER_TILES;
+  int y = y_of(tile) - c / _cols * CLUSTER_TILES;
+  return y * CLUSTER_TILES + x;
+}
+
+size_t hpa_finder::tile_of(int c, int local) const {
+  int x = c % _cols * CLUSTER_TILES + local % CLUSTER_TILES;
+  int y = c / _cols * CLUSTER_TILES + local / CLUSTER_TILES;
+  return tile_at(x, y);
+}
+
+void hpa_finder::build_border(int c, bool right, const passable_t& walkable) {
+  vector<transition_t>& border = right ? _right[c] : _down[c];
+  border.clear();
+  int x0 = c % _cols * CLUSTER_TILES;
+  int y0 = c / _cols * CLUSTER_TILES;
+  // pairs of tiles facing each other across the border
+  int x = right ? x0 + CLUSTER_TILES - 1 : x0;
+  int y = right ? y0 : y0 + CLUSTER_TILES - 1;
+  int dx = right ? 0 : 1;
+  int dy = right ? 1 : 0;
+  int length = min(CLUSTER_TILES, right ? _h - y0 : _w - x0);
+  if ((right && x + 1 >= _w) || (!right && y + 1 >= _h)) {
+    return;
+  }
+  int run = 0; // open pairs so far
+  for (int i = 0; i <= length; ++i) {
+    int ax = x + i * dx;
+    int ay = y + i * dy;
+    int bx = ax + 1 - dx;
+    int by = ay + 1 - dy;
+    if (i < length && walkable(ax, ay) && walkable(bx, by)) {
+      ++run;
+      continue;
+    }
+    if (run == 0) {
+      continue;
+    }
+    // one entrance in the middle of narrow openings, one per end otherwise
+    int first = i - run;
+    int last = i - 1;
+    if (run < MAX_ENTRANCE) {
+      first = last = first + run / 2;
+    }
+    transition_t t;
+    t.inside = tile_at(x + first * dx, y + first * dy);
+    t.outside = t.inside + (right ? 1 : _w);
+    border.push_back(t);
+    if (last != first) {
+      t.inside = tile_at(x + last * dx, y + last * dy);
+      t.outside = t.inside + (right ? 1 : _w);
+      border.push_back(t);
+    }
+    run = 0;
+  }
+}
+
+void hpa_finder::build_cluster(int c, const passable_t& walkable) {
+  cluster_t& cl = _clusters[c];
+  cl.nodes.clear();
+  cl.links.clear();
+  // transitions of the borders around the cluster, from its side
+  vector<transition_t> transitions(_right[c].begin(), _right[c].end());
+  transitions.insert(transitions.end(), _down[c].begin(), _down[c].end());
+  if (c % _cols > 0) {
+    const vector<transition_t>& left = _right[c - 1];
+    for (size_t i = 0; i < left.size(); ++i) {
+      transition_t t = {left[i].outside, left[i].inside};
+      transitions.push_back(t);
+    }
+  }
+  if (c / _cols > 0) {
+    const vector<transition_t>& up = _down[c - _cols];
+    for (size_t i = 0; i < up.size(); ++i) {
+      transition_t t = {up[i].outside, up[i].inside};
+      transitions.push_back(t);
+    }
+  }
+  for (size_t i = 0; i < transitions.size(); ++i) {
+    int node = node_of(cl, transitions[i].inside);
+    if (node == -1) {
+      node = int(cl.nodes.size());
+      cl.nodes.push_back(transitions[i].inside);
+      cl.links.push_back(vector<size_t>());
+    }
+    cl.links[node].push_back(transitions[i].outside);
+  }
+
+  int n = int(cl.nodes.size());
+  cl.dist.assign(size_t(n) * n, -1);
+  pos_t none = {0, 0};
+  for (int i = 0; i < n; ++i) {
+    search_cluster(c, cl.nodes[i], walkable, none, -1);
+    for (int j = 0; j < n; ++j) {
+      cl.dist[i * n + j] = _local[local_of(c, cl.nodes[j])];
+    }
+  }
+}
+
+size_t hpa_finder::search_cluster(int c, size_t from,
+                                  const passable_t& passable, pos_t dest,
+                                  int range) {
+  int x0 = c % _cols * CLUSTER_TILES;
+  int y0 = c / _cols * CLUSTER_TILES;
+  int x1 = min(x0 + CLUSTER_TILES, _w);
+  int y1 = min(y0 + CLUSTER_TILES, _h);
+  fill(_local.begin(), _local.end(), -1);
+  vector<char> closed(CLUSTER_AREA, false);
+  _open.clear();
+  int origin = local_of(c, from);
+  _local[origin] = 0;
+  _parent[origin] = -1;
+  _open.push_back(make_pair(0, origin));
+  while (!_open.empty()) {
+    pop_heap(_open.begin(), _open.end(), greater<entry_t>());
+    int cur = int(_open.back().second);
+    _open.pop_back();
+    if (closed[cur]) {
+      continue;
+    }
+    closed[cur] = true;
+    ++_expanded;
+
+    int x = x0 + cur % CLUSTER_TILES;
+    int y = y0 + cur / CLUSTER_TILES;
+    if (range >= 0 && abs(x - dest.x) <= range && abs(y - dest.y) <= range) {
+      return tile_of(c, cur);
+    }
+    for (int dir = 0; dir < 9; ++dir) {
+      int nx = x + dir % 3 - 1;
+      int ny = y + dir / 3 - 1;
+      if (dir == 4 || nx < x0 || nx >= x1 || ny < y0 || ny >= y1) {
+        continue;
+      }
+      int next = (ny - y0) * CLUSTER_TILES + nx - x0;
+      if (closed[next] || !passable(nx, ny)) {
+        continue;
+      }
+      int cost = _local[cur] + (dir % 2 == 0 ? DIAGONAL_COST : STRAIGHT_COST);
+      if (_local[next] == -1 || cost < _local[next]) {
+        _local[next] = cost;
+        _parent[next] = cur;
+        _open.push_back(make_pair(cost, next));
+        push_heap(_open.begin(), _open.end(), greater<entry_t>());
+      }
+    }
+  }
+  return NO_TILE;
+}
+
+void hpa_finder::append_path(int c, size_t tile, deque<pos_t>& path) const {
+  size_t end = path.size();
+  for (int cur = local_of(c, tile); _parent[cur] != -1; cur = _parent[cur]) {
+    size_t t = tile_of(c, cur);
+    pos_t p = {x_of(t), y_of(t)};
+    path.insert(path.begin() + end, p);
+  }
+}
@@ -0,0 +1,98 @@
+#ifndef HPA_HPP
+#define HPA_HPP
+
+#include <cstddef>
+#include <deque>
+#include <utility>
+#include <vector>
+#include "pathfinding.hpp"
+
+// hierarchical pathfinding (HPA*), the map is cut in square clusters joined
+// by entrances on their borders, the distances between the entrances of a
+// cluster are cached so long paths are first searched over the entrances
+// then refined inside each cluster they cross
+// the clusters only know the walls, characters are avoided while refining
+class hpa_finder {
+public:
+  static const int CLUSTER_TILES = 16; // cluster side
+  static const int MAX_ENTRANCE = 6; // wider openings get an entrance per end
+
+  hpa_finder();
+
+  // rebuilds the clusters if the map size or version changed since the last
+  // call, only the clusters around changed tiles if every change since then
+  // went through tile_changed
+  void update(int w, int h, const passable_t& walkable, size_t map_version);
+  // the tile was edited, which made the map version map_version
+  void tile_changed(int x, int y, size_t map_version);
+
+  // from start to the first tile within range of dest (square range), the
+  // entrances come from walkable and the refined path from can_enter, path
+  // gets the tiles to walk excluding start, false if there is none
+  bool find(const passable_t& walkable, const passable_t& can_enter,
+            pos_t start, pos_t dest, int range, std::deque<pos_t>& path);
+  // entrances and tiles expanded by the last query
+  size_t expanded() const { return _expanded; }
+  // entrances of the whole map
+  size_t nodes() const;
+
+private:
+  static const size_t NO_TILE = size_t(-1);
+
+  // tiles of the map are y * w + x, tiles of a cluster their offset from
+  // its top left corner
+  typedef std::pair<int, size_t> entry_t; // (f, tile)
+  typedef struct {
+    size_t inside; // tile of the cluster
+    size_t outside; // tile of the next cluster it leads to
+  } transition_t;
+  typedef struct {
+    std::vector<size_t> nodes; // tiles
+    std::vector<std::vector<size_t> > links; // by node, tiles it leads to
+    std::vector<int> dist; // between nodes inside the cluster, -1 if none
+  } cluster_t;
+
+  size_t tile_at(int x, int y) const { return size_t(y) * _w + x; }
+  int x_of(size_t tile) const { return int(tile % _w); }
+  int y_of(size_t tile) const { return int(tile / _w); }
+  int cluster_of(size_t tile) const;
+  int cluster_of(int x, int y) const {
+    return (y / CLUSTER_TILES) * _cols + x / CLUSTER_TILES;
+  }
+  int node_of(const cluster_t& c, size_t tile) const;
+  int local_of(int c, size_t tile) const;
+  size_t tile_of(int c, int local) const;
+
+  // entrances on the border with the cluster to the right or below
+  void build_border(int c, bool right, const passable_t& walkable);
+  void build_cluster(int c, const passable_t& walkable);
+
+  // dijkstra inside a cluster from a tile, fills _local with the cost to
+  // every tile of the cluster, -1 if unreachable, returns the first tile
+  // closed within range of dest or NO_TILE, a negative range searches
+  // everything
+  size_t search_cluster(int c, size_t from, const passable_t& passable,
+                        pos_t dest, int range);
+  // appends the tiles from the origin of the last search_cluster to one of
+  // the tiles it reached
+  void append_path(int c, size_t tile, std::deque<pos_t>& path) const;
+
+  int _w;
+  int _h;
+  int _cols; // clusters per row
+  int _rows;
+  size_t _map_version;
+  std::vector<std::vector<transition_t> > _right; // by cluster
+  std::vector<std::vector<transition_t> > _down;
+  std::vector<cluster_t> _clusters;
+  std::vector<char> _is_dirty; // by cluster
+  std::vector<int> _dirty;
+
+  // buffers of the local searches, by tile of the cluster
+  std::vector<int> _local;
+  std::vector<int> _parent;
+  std::vector<entry_t> _open;
+  size_t _expanded;
+};
+
+#endif // HPA_HPP
@@ -61,11 +61,10 @@ inline bool process_input(const SDL_Event& e, Device& d, Game& g) {
       g.set_focus();
       break;
     case SDLK_RETURN:
-      if (!d.is_edit_mode && g.characters[g.turns[0]].is_playable) {
-        std::vector<size_t> list = g.attack_range();
+      if (!d.is_edit_mode && g.characters[g.turns.current()].is_playable) {
+        std::vector<character_handle> list = g.attack_range();
         if (!list.empty()) {
-          srand(clock());
-          g.attack(list[rand() % list.size()]);
+          g.attack(list[g.dice.roll(list.size())]);
           g.end_turn();
         }
       }
@@ -79,28 +78,28 @@ inline bool process_input(const SDL_Event& e, Device& d, Game& g) {
     case SDLK_w: case SDLK_UP:
       if (d.is_edit_mode) {
         --g.focus_y;
-      } else if (g.characters[g.turns[0]].is_playable) {
+      } else if (g.characters[g.turns.current()].is_playable) {
         g.move(0, -1);
       }
       break;
     case SDLK_a: case SDLK_LEFT:
       if (d.is_edit_mode) {
         --g.focus_x;
-      } else if (g.characters[g.turns[0]].is_playable) {
+      } else if (g.characters[g.turns.current()].is_playable) {
         g.move(-1, 0);
       }
       break;
     case SDLK_s: case SDLK_x: case SDLK_DOWN:
       if (d.is_edit_mode) {
         ++g.focus_y;
-      } else if (g.characters[g.turns[0]].is_playable) {
+      } else if (g.characters[g.turns.current()].is_playable) {
         g.move(0, 1);
       }
       break;
     case SDLK_d: case SDLK_RIGHT:
       if (d.is_edit_mode) {
         ++g.focus_x;
-      } else if (g.characters[g.turns[0]].is_playable) {
+      } else if (g.characters[g.turns.current()].is_playable) {
         g.move(1, 0);
       }
       break;
@@ -109,7 +108,7 @@ inline bool process_input(const SDL_Event& e, Device& d, Game& g) {
       if (d.is_edit_mode) {
         --g.focus_x;
         --g.focus_y;
-      } else if (g.characters[g.turns[0]].is_playable) {
+      } else if (g.characters[g.turns.current()].is_playable) {
         g.move(-1, -1);
       }
       break;
@@ -117,7 +116,7 @@ inline bool process_input(const SDL_Event& e, Device& d, Game& g) {
       if (d.is_edit_mode) {
         ++g.focus_x;
         --g.focus_y;
-      } else if (g.characters[g.turns[0]].is_playable) {
+      } else if (g.characters[g.turns.current()].is_playable) {
         g.move(1, -1);
       }
       break;
@@ -125,7 +124,7 @@ inline bool process_input(const SDL_Event& e, Device& d, Game& g) {
       if (d.is_edit_mode) {
         --g.focus_x;
         ++g.focus_y;
-      } else if (g.characters[g.turns[0]].is_playable) {
+      } else if (g.characters[g.turns.current()].is_playable) {
         g.move(-1, 1);
       }
       break;
@@ -133,89 +132,71 @@ inline bool process_input(const SDL_Event& e, Device& d, Game& g) {
       if (d.is_edit_mode) {
         ++g.focus_x;
         ++g.focus_y;
-      } else if (g.characters[g.turns[0]].is_playable) {
+      } else if (g.characters[g.turns.current()].is_playable) {
         g.move(1, 1);
       }
       break;
     // other keys
     case SDLK_1:
       if (d.is_edit_mode) {
-        g.map[g.focus_y][g.focus_x] = 0;
+        g.set_tile(g.focus_x, g.focus_y, 0);
+        d.invalidate_tile(g.focus_x, g.focus_y);
       }
       break;
     case SDLK_2:
       if (d.is_edit_mode) {
-        g.map[g.focus_y][g.focus_x] = 1;
+        g.set_tile(g.focus_x, g.focus_y, 1);
+        d.invalidate_tile(g.focus_x, g.focus_y);
       }
       break;
     case SDLK_3:
       if (d.is_edit_mode) {
-        g.map[g.focus_y][g.focus_x] = 2;
+        g.set_tile(g.focus_x, g.focus_y, 2);
+        d.invalidate_tile(g.focus_x, g.focus_y);
       }
       break;
     case SDLK_4:
       if (d.is_edit_mode) {
-        g.map[g.focus_y][g.focus_x] = 3;
+        g.set_tile(g.focus_x, g.focus_y, 3);
+        d.invalidate_tile(g.focus_x, g.focus_y);
       }
       break;
     case SDLK_0:
-      if (d.is_edit_mode && g.map[g.focus_y][g.focus_x] != 3) {
-        g.characters[0].pos.x = g.focus_x;
-        g.characters[0].pos.y = g.focus_y;
+      if (d.is_edit_mode && g.map.contains(g.focus_x, g.focus_y) &&
+          g.map(g.focus_x, g.focus_y) != 3 &&
+          !g.is_tile_occupied(g.focus_x, g.focus_y) &&
+          !g.characters.empty()) {
+        g.place_character(g.characters.handle_at(0), g.focus_x, g.focus_y);
       }
       break;
     case SDLK_9:
-      if (d.is_edit_mode && g.map[g.focus_y][g.focus_x] != 3) {
-        bool found = false;
-        size_t idx = 0;
-        for (size_t i = 0; i < g.characters.size(); ++i) {
-          const character& ch = g.characters[i];
-          if (ch.pos.x == g.focus_x && ch.pos.y == g.focus_y) {
-            found = true;
-            idx = i;
-            break;
-          }
-        }
-        if (found) {
-          g.delete_character(idx);
+      if (d.is_edit_mode && g.map.contains(g.focus_x, g.focus_y) &&
+          g.map(g.focus_x, g.focus_y) != 3) {
+        character_handle ch = g.character_at(g.focus_x, g.focus_y);
+        if (ch != NO_HANDLE) {
+          g.delete_character(ch);
         } else {
           g.create_enemy(0, g.focus_x, g.focus_y);
         }
       }
       break;
     case SDLK_8:
-      if (d.is_edit_mode && g.map[g.focus_y][g.focus_x] != 3) {
-        bool found = false;
-        size_t idx = 0;
-        for (size_t i = 0; i < g.characters.size(); ++i) {
-          const character& ch = g.characters[i];
-          if (ch.pos.x == g.focus_x && ch.pos.y == g.focus_y) {
-            found = true;
-            idx = i;
-            break;
-          }
-        }
-        if (found) {
-          g.delete_character(idx);
+      if (d.is_edit_mode && g.map.contains(g.focus_x, g.focus_y) &&
+          g.map(g.focus_x, g.focus_y) != 3) {
+        character_handle ch = g.character_at(g.focus_x, g.focus_y);
+        if (ch != NO_HANDLE) {
+          g.delete_character(ch);
         } else {
           g.create_enemy(1, g.focus_x, g.focus_y);
         }
       }
       break;
     case SDLK_7:
-      if (d.is_edit_mode && g.map[g.focus_y][g.focus_x] != 3) {
-        bool found = false;
-        size_t idx = 0;
-        for (size_t i = 0; i < g.characters.size(); ++i) {
-          const character& ch = g.characters[i];
-          if (ch.pos.x == g.focus_x && ch.pos.y == g.focus_y) {
-            found = true;
-            idx = i;
-            break;
-          }
-        }
-        if (found) {
-          g.delete_character(idx);
+      if (d.is_edit_mode && g.map.contains(g.focus_x, g.focus_y) &&
+          g.map(g.focus_x, g.focus_y) != 3) {
+        character_handle ch = g.character_at(g.focus_x, g.focus_y);
+        if (ch != NO_HANDLE) {
+          g.delete_character(ch);
         } else {
           g.create_enemy(3, g.focus_x, g.focus_y);
         }
@@ -228,7 +209,7 @@ inline bool process_input(const SDL_Event& e, Device& d, Game& g) {
       break;
     case SDLK_t:
       if (d.is_edit_mode) {
-        d.random_seed = rand();
+        d.random_seed = g.dice.next();
       }
       break;
     case SDLK_m:
@@ -237,6 +218,15 @@ inline bool process_input(const SDL_Event& e, Device& d, Game& g) {
         std::cout << "Map file: ";
         std::cin >> file;
         g.load_map("assets/" + file);
+        d.invalidate_map();
+      }
+      break;
+    case SDLK_b:
+      if (d.is_edit_mode) {
+        std::string file;
+        std::cout << "Save binary map as: ";
+        std::cin >> file;
+        write_map("assets/" + file, g.materials, g.map, true);
       }
       break;
     case SDLK_LEFTBRACKET:
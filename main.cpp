@@ -1,5 +1,6 @@
 #include <cstdio>
 #include <cstdlib>
+#include <ctime>
 #include <string>
 #include "config.hpp"
 #include "device.hpp"
@@ -12,9 +13,11 @@ const int SCREEN_WIDTH = 1024;
 const int SCREEN_HEIGHT = 768;
 
 const int FRAME_CAP = 60;
-const int FRAME_CAP_MS = 1000 / FRAME_CAP;
+const unsigned int FRAME_CAP_MS = 1000 / FRAME_CAP;
 
-const int AI_UPDATE = 10; // in frames
+const int TICK_RATE = 60; // simulation ticks per second
+const unsigned int TICK_MS = 1000 / TICK_RATE;
+const int MAX_TICKS_PER_FRAME = 10; // after a stall the lost time is dropped
 
 const string MATERIALS_FILENAME = "assets/materials";
 const string MAP_FILENAME = "assets/map_blank";
@@ -22,33 +25,53 @@ const string CHARACTERS_FILENAME = "assets/characters";
 const string ENEMIES_FILENAME = "assets/enemies";
 
 extern int g_dijkstra_speed;
-extern int g_iterations;
-extern int HIGH_AI_TOTAL_ITERATIONS;
 
-int main(int, char**) {
+int main(int argc, char** argv) {
   printf("Dungeon Master v%d.%d\n", VERSION_MAJOR, VERSION_MINOR);
   puts("Designed and programmed by: David Cavazos");
   puts("Music from: Dwarf Fortress");
 
+  // pass the seed of a previous run to replay it
+  unsigned long long seed = argc > 1 ? strtoull(argv[1], NULL, 10) : time(0);
+  printf("Seed: %llu\n", seed);
+
   Device dev(SCREEN_WIDTH, SCREEN_HEIGHT);
-  Game g(dev, MATERIALS_FILENAME, MAP_FILENAME, CHARACTERS_FILENAME,
-         ENEMIES_FILENAME);
+  Game g([&dev](const string& file) { return dev.load_image(file); },
+         MATERIALS_FILENAME, MAP_FILENAME, CHARACTERS_FILENAME,
+         ENEMIES_FILENAME, seed);
 
   puts("Running game loop");
   char buffer[64];
   unsigned int start_time;
   unsigned int delta_time;
+  unsigned int last_time = dev.get_time();
+  unsigned int lag = 0; // simulation time owed
   bool is_running = true;
   while (is_running) {
     start_time = dev.get_time();
+    lag += start_time - last_time;
+    last_time = start_time;
 
-    // game logic
+    // game logic, at a fixed rate no matter how fast frames are drawn
     is_running = dev.process_events(g);
-    if (!dev.is_edit_mode) {
-      process_ai(g);
-    }
-    if (g_dijkstra_speed < 1 && g_iterations < HIGH_AI_TOTAL_ITERATIONS) {
-      continue;
+    if (dev.is_edit_mode) {
+      lag = 0;
+    } else if (g_dijkstra_speed < 1 && is_ai_turn(g)) {
+      // fast forward through the AI turns, simulate flat out and only stop
+      // once a frame to draw and read input
+      do {
+        process_ai(g);
+      } while (is_ai_turn(g) && dev.get_time() - start_time < FRAME_CAP_MS);
+      lag = 0;
+    } else {
+      for (int ticks = 0; lag >= TICK_MS && ticks < MAX_TICKS_PER_FRAME;
+           ++ticks) {
+        process_ai(g);
+        lag -= TICK_MS;
+      }
+      if (lag >= TICK_MS) {
+        lag = 0;
+      }
     }
 
     // draw to screen
@@ -0,0 +1,373 @@
+#include "map_file.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include "mapped_file.hpp"
+#include "tokenizer.hpp"
+
+using namespace std;
+
+// binary maps, integers are little endian:
+//   "DMAP", u16 version, u16 flags
+//   u32 width, u32 height
+//   u16 number of materials, then every name as u8 length and characters
+//   the tiles row by row as u8 indices in that material table, or with
+//   MAP_RLE runs of u32 length and u8 index
+const char MAP_MAGIC[4] = {'D', 'M', 'A', 'P'};
+const uint16_t MAP_VERSION = 1;
+const uint16_t MAP_RLE = 1;
+const uint32_t MAP_MAX_SIDE = 1 << 16;
+
+vector<material> read_materials(const string& file,
+                                const image_loader_t& load_image) {
+  vector<material> materials;
+  tokenizer t;
+  if (!t.open(file)) {
+    fprintf(stderr, "Error opening file: %s\n", file.c_str());
+    exit(EXIT_FAILURE);
+  }
+  while (t.next_line()) {
+    material mat;
+    mat.name = t.read_string();
+    mat.image = load_image(t.read_string());
+    mat.pos_x = t.read_int();
+    mat.pos_y = t.read_int();
+    mat.n_x = t.read_int();
+    mat.n_y = t.read_int();
+    mat.is_walkable = t.read_int();
+    materials.push_back(mat);
+  }
+  if (materials.size() >= TILE_NONE) {
+    fprintf(stderr, "Error: too many materials in %s\n", file.c_str());
+    exit(EXIT_FAILURE);
+  }
+  return materials;
+}
+
+// material of a map tile, TILE_NONE is reserved for the border
+tile_t read_tile(tokenizer& t) {
+  int tile = t.read_int();
+  if (tile < 0 || tile >= TILE_NONE) {
+    t.error("invalid material");
+  }
+  return tile;
+}
+
+void read_text_map(tokenizer& t, grid<tile_t>& map) {
+  // the first row gives the number of columns
+  vector<tile_t> tiles;
+  if (t.next_line()) {
+    while (t.has_field()) {
+      tiles.push_back(read_tile(t));
+    }
+  }
+  size_t w = tiles.size();
+
+  // read rest of map, incomplete information will be filled with material 0
+  while (t.next_line()) {
+    size_t row = tiles.size();
+    tiles.resize(row + w, 0);
+    for (size_t i = 0; i < w && t.has_field(); ++i) {
+      tiles[row + i] = read_tile(t);
+    }
+  }
+  int h = w > 0 ? tiles.size() / w : 0;
+  map.assign(w, h, 0, TILE_NONE);
+  for (int y = 0; y < h; ++y) {
+    memcpy(&map(0, y), &tiles[y * w], w);
+  }
+}
+
+// bounds checked little endian reads from a mapped binary map
+class map_reader {
+public:
+  map_reader(const char* data, size_t size)
+    : _pos(reinterpret_cast<const uint8_t*>(data)), _end(_pos + size) {}
+
+  bool has(size_t n) const { return size_t(_end - _pos) >= n; }
+  size_t left() const { return _end - _pos; }
+  const uint8_t* take(size_t n) {
+    const uint8_t* p = _pos;
+    _pos += n;
+    return p;
+  }
+
+  // the caller checked there are enough bytes
+  uint8_t u8() { return *_pos++; }
+  uint16_t u16() {
+    const uint8_t* p = take(2);
+    return p[0] | p[1] << 8;
+  }
+  uint32_t u32() {
+    const uint8_t* p = take(4);
+    return p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24;
+  }
+
+private:
+  const uint8_t* _pos;
+  const uint8_t* _end;
+};
+
+bool map_error(const string& file, const char* what) {
+  fprintf(stderr, "Error: %s: %s\n", file.c_str(), what);
+  return false;
+}
+
+bool is_binary_map(const char* data, size_t size) {
+  return size >= sizeof(MAP_MAGIC) &&
+         memcmp(data, MAP_MAGIC, sizeof(MAP_MAGIC)) == 0;
+}
+
+bool read_map_header(const string& file, const char* data, size_t size,
+                     const vector<material>& materials, map_header_t& header) {
+  map_reader r(data, size);
+  if (!r.has(sizeof(MAP_MAGIC) + 14)) {
+    return map_error(file, "truncated header");
+  }
+  r.take(sizeof(MAP_MAGIC));
+  if (r.u16() != MAP_VERSION) {
+    return map_error(file, "unsupported version");
+  }
+  uint16_t flags = r.u16();
+  uint32_t w = r.u32();
+  uint32_t h = r.u32();
+  if (w > MAP_MAX_SIDE || h > MAP_MAX_SIDE) {
+    return map_error(file, "map too large");
+  }
+
+  tile_t* remap = header.remap;
+  memset(remap, TILE_NONE, sizeof(header.remap));
+  uint16_t n = r.u16();
+  if (n > TILE_NONE) {
+    return map_error(file, "too many materials");
+  }
+  for (uint16_t i = 0; i < n; ++i) {
+    if (!r.has(1)) {
+      return map_error(file, "truncated material table");
+    }
+    uint8_t length = r.u8();
+    if (!r.has(length)) {
+      return map_error(file, "truncated material table");
+    }
+    const char* name = reinterpret_cast<const char*>(r.take(length));
+    for (size_t m = 0; m < materials.size(); ++m) {
+      if (materials[m].name.size() == length &&
+          memcmp(materials[m].name.data(), name, length) == 0) {
+        remap[i] = m;
+        break;
+      }
+    }
+    if (remap[i] == TILE_NONE) {
+      fprintf(stderr, "Error: %s: unknown material %.*s\n", file.c_str(),
+              int(length), name);
+      return false;
+    }
+  }
+
+  header.width = w;
+  header.height = h;
+  header.materials = n;
+  header.is_compressed = flags & MAP_RLE;
+  header.tiles = size - r.left();
+  if (!header.is_compressed && r.left() < size_t(w) * h) {
+    return map_error(file, "truncated tiles");
+  }
+  return true;
+}
+
+bool read_binary_map(const string& file, const char* data, size_t size,
+                     const vector<material>& materials, grid<tile_t>& map) {
+  map_header_t header;
+  if (!read_map_header(file, data, size, materials, header)) {
+    return false;
+  }
+  map_reader r(data + header.tiles, size - header.tiles);
+  uint32_t w = header.width;
+  uint32_t h = header.height;
+  uint16_t n = header.materials;
+  const tile_t* remap = header.remap;
+
+  // decoded into a new grid so a bad file leaves the map as it was
+  grid<tile_t> tiles;
+  tiles.assign(w, h, 0, TILE_NONE);
+  bool is_valid = true;
+  if (header.is_compressed) {
+    uint32_t x = 0;
+    uint32_t y = 0;
+    while (y < h) {
+      if (!r.has(5)) {
+        return map_error(file, "truncated tiles");
+      }
+      uint32_t run = r.u32();
+      tile_t tile = remap[r.u8()];
+      is_valid = is_valid && tile != TILE_NONE;
+      // runs wrap from the end of a row to the start of the next one
+      while (run > 0 && y < h) {
+        uint32_t count = min(run, w - x);
+        memset(&tiles(x, y), tile, count);
+        run -= count;
+        x += count;
+        if (x == w) {
+          x = 0;
+          ++y;
+        }
+      }
+      if (run > 0) {
+        return map_error(file, "too many tiles");
+      }
+    }
+  } else {
+    // the file usually has the same materials in the same order, its rows
+    // are copied as they are then
+    bool is_identity = true;
+    for (uint16_t i = 0; i < n; ++i) {
+      is_identity = is_identity && remap[i] == i;
+    }
+    uint8_t max_tile = 0;
+    for (uint32_t y = 0; y < h; ++y) {
+      const uint8_t* src = r.take(w);
+      tile_t* dst = &tiles(0, y);
+      if (is_identity) {
+        memcpy(dst, src, w);
+        for (uint32_t x = 0; x < w; ++x) {
+          max_tile = max(max_tile, src[x]);
+        }
+      } else {
+        for (uint32_t x = 0; x < w; ++x) {
+          dst[x] = remap[src[x]];
+          is_valid = is_valid && dst[x] != TILE_NONE;
+        }
+      }
+    }
+    is_valid = is_valid && (w == 0 || h == 0 || max_tile < n);
+  }
+  if (!is_valid) {
+    return map_error(file, "invalid material");
+  }
+  map = move(tiles);
+  return true;
+}
+
+bool read_map(const string& file, const vector<material>& materials,
+              grid<tile_t>& map) {
+  mapped_file f;
+  if (!f.open(file)) {
+    fprintf(stderr, "Error opening file: %s\n", file.c_str());
+    return false;
+  }
+  if (is_binary_map(f.data(), f.size())) {
+    return read_binary_map(file, f.data(), f.size(), materials, map);
+  }
+  tokenizer t;
+  t.open(f.data(), f.size(), file);
+  read_text_map(t, map);
+  return true;
+}
+
+void put_u16(vector<uint8_t>& out, uint16_t value) {
+  out.push_back(value & 0xff);
+  out.push_back(value >> 8);
+}
+
+void put_u32(vector<uint8_t>& out, uint32_t value) {
+  put_u16(out, value & 0xffff);
+  put_u16(out, value >> 16);
+}
+
+// tiles of the map in runs of the same material, row after row
+template <class F>
+void for_each_run(const world_map& map, F run) {
+  uint32_t length = 0;
+  tile_t tile = 0;
+  for (int y = 0; y < map.height(); ++y) {
+    for (int x = 0; x < map.width(); ++x) {
+      if (length > 0 && map(x, y) != tile) {
+        run(length, tile);
+        length = 0;
+      }
+      tile = map(x, y);
+      ++length;
+    }
+  }
+  if (length > 0) {
+    run(length, tile);
+  }
+}
+
+// out is written to f once it holds this many bytes, so huge maps are never
+// whole in memory
+const size_t WRITE_BUFFER = 1 << 20;
+
+bool flush(FILE* f, vector<uint8_t>& out) {
+  bool is_written = fwrite(out.data(), 1, out.size(), f) == out.size();
+  out.clear();
+  return is_written;
+}
+
+bool write_map(const string& file, const vector<material>& materials,
+               const world_map& map, bool compress) {
+  // maps without long runs are smaller raw
+  if (compress) {
+    size_t runs = 0;
+    for_each_run(map, [&runs](uint32_t, tile_t) { ++runs; });
+    compress = runs * 5 < size_t(map.width()) * map.height();
+  }
+
+  vector<uint8_t> out(MAP_MAGIC, MAP_MAGIC + sizeof(MAP_MAGIC));
+  put_u16(out, MAP_VERSION);
+  put_u16(out, compress ? MAP_RLE : 0);
+  put_u32(out, map.width());
+  put_u32(out, map.height());
+  put_u16(out, materials.size());
+  for (size_t i = 0; i < materials.size(); ++i) {
+    const string& name = materials[i].name;
+    if (name.size() > UINT8_MAX) {
+      fprintf(stderr, "Error: material name too long: %s\n", name.c_str());
+      return false;
+    }
+    out.push_back(name.size());
+    out.insert(out.end(), name.begin(), name.end());
+  }
+
+  string temp = file + ".tmp";
+  FILE* f = fopen(temp.c_str(), "wb");
+  if (f == NULL) {
+    fprintf(stderr, "Error opening file: %s\n", temp.c_str());
+    return false;
+  }
+  bool is_written = true;
+  if (compress) {
+    for_each_run(map, [&](uint32_t length, tile_t tile) {
+      put_u32(out, length);
+      out.push_back(tile);
+      if (out.size() >= WRITE_BUFFER) {
+        is_written = flush(f, out) && is_written;
+      }
+    });
+  } else {
+    for (int y = 0; y < map.height(); ++y) {
+      for (int x = 0; x < map.width(); ++x) {
+        out.push_back(map(x, y));
+      }
+      if (out.size() >= WRITE_BUFFER) {
+        is_written = flush(f, out) && is_written;
+      }
+    }
+  }
+  is_written = flush(f, out) && is_written;
+  is_written = fclose(f) == 0 && is_written;
+  // windows doesn't rename over existing files
+  if (is_written && rename(temp.c_str(), file.c_str()) != 0) {
+    remove(file.c_str());
+    is_written = rename(temp.c_str(), file.c_str()) == 0;
+  }
+  if (!is_written) {
+    fprintf(stderr, "Error writing file: %s\n", file.c_str());
+    remove(temp.c_str());
+  }
+  return is_written;
+}
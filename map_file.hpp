@@ -0,0 +1,49 @@
+#ifndef MAP_FILE_HPP
+#define MAP_FILE_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "grid.hpp"
+#include "material.hpp"
+#include "world_map.hpp"
+
+// loads an image and returns its index, headless games can return anything
+typedef std::function<size_t(const std::string& file)> image_loader_t;
+
+// exits if the file can't be read or has more materials than tile_t holds
+std::vector<material> read_materials(const std::string& file,
+                                     const image_loader_t& load_image);
+
+// maps are either text, the material of every tile with one line per row, or
+// binary as written by write_map, told apart by their first bytes
+// binary maps name their materials, so they still load if the material file
+// is reordered
+// false if the file can't be read or a binary map is not valid, the map is
+// left untouched then, malformed text exits like the other assets
+bool read_map(const std::string& file, const std::vector<material>& materials,
+              grid<tile_t>& map);
+
+// layout of a binary map, raw tiles can be read straight from the file
+typedef struct {
+  int width;
+  int height;
+  int materials; // in the file
+  bool is_compressed;
+  size_t tiles; // offset of the tiles in the file
+  tile_t remap[256]; // material in the file to index in materials
+} map_header_t;
+
+bool is_binary_map(const char* data, size_t size);
+// false if the header is not valid, after saying why
+bool read_map_header(const std::string& file, const char* data, size_t size,
+                     const std::vector<material>& materials,
+                     map_header_t& header);
+
+// binary, tiles run length encoded if compress
+// written next to the file and renamed over it, so a map streamed from the
+// file can be saved back to it
+bool write_map(const std::string& file, const std::vector<material>& materials,
+               const world_map& map, bool compress);
+
+#endif // MAP_FILE_HPP
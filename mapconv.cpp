@@ -0,0 +1,60 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "map_file.hpp"
+
+using namespace std;
+
+const string MATERIALS_FILENAME = "assets/materials";
+
+void usage(const char* name) {
+  fprintf(stderr,
+          "Usage: %s [options] INPUT OUTPUT\n"
+          "Converts a text or binary map to the binary map format.\n"
+          "  -m FILE  material file (default %s)\n"
+          "  -r       run length encode the tiles, such maps are read whole\n"
+          "           instead of streamed\n",
+          name, MATERIALS_FILENAME.c_str());
+}
+
+int main(int argc, char** argv) {
+  string mat_file = MATERIALS_FILENAME;
+  bool compress = false;
+  vector<string> files;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-r") == 0) {
+      compress = true;
+    } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+      mat_file = argv[++i];
+    } else if (argv[i][0] != '-') {
+      files.push_back(argv[i]);
+    } else {
+      files.clear();
+      break;
+    }
+  }
+  if (files.size() != 2) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  vector<material> materials = read_materials(
+      mat_file, [](const string&) { return size_t(0); });
+  world_map map;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  if (!map.load(files[0], materials)) {
+    return EXIT_FAILURE;
+  }
+  double secs =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  printf("Read %s, %dx%d tiles in %.1f ms\n", files[0].c_str(), map.width(),
+         map.height(), secs * 1000);
+  if (!write_map(files[1], materials, map, compress)) {
+    return EXIT_FAILURE;
+  }
+  printf("Wrote %s\n", files[1].c_str());
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+#include "mapped_file.hpp"
+
+#include <cstdio>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+bool mapped_file::open(const string& file) {
+  close();
+#ifndef _WIN32
+  int fd = ::open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+  _size = st.st_size;
+  if (_size > 0) {
+    void* data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      _data = static_cast<const char*>(data);
+      _is_mapped = true;
+    }
+  }
+  ::close(fd);
+#endif
+  if (!_is_mapped) {
+    FILE* f = fopen(file.c_str(), "rb");
+    if (f == NULL) {
+      return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    _buffer.resize(size > 0 ? size : 0);
+    _size = fread(_buffer.data(), 1, _buffer.size(), f);
+    fclose(f);
+    _data = _buffer.data();
+  }
+  return true;
+}
+
+void mapped_file::close() {
+#ifndef _WIN32
+  if (_is_mapped) {
+    munmap(const_cast<char*>(_data), _size);
+  }
+#endif
+  _is_mapped = false;
+  _buffer.clear();
+  _data = NULL;
+  _size = 0;
+}
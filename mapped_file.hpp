@@ -0,0 +1,32 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// read only view of a whole file, memory mapped where possible and read
+// into memory otherwise
+class mapped_file {
+public:
+  mapped_file() : _data(NULL), _size(0), _is_mapped(false) {}
+  ~mapped_file() { close(); }
+
+  // false if the file can't be read
+  bool open(const std::string& file);
+  void close();
+
+  const char* data() const { return _data; }
+  size_t size() const { return _size; }
+
+private:
+  mapped_file(const mapped_file&);
+  mapped_file& operator=(const mapped_file&);
+
+  const char* _data;
+  size_t _size;
+  bool _is_mapped;
+  std::vector<char> _buffer; // where files can't be mapped
+};
+
+#endif // MAPPED_FILE_HPP
@@ -1,8 +1,13 @@
 #ifndef MATERIAL_HPP
 #define MATERIAL_HPP
 
+#include <cstdint>
 #include <string>
 
+// material index of a map tile
+typedef uint8_t tile_t;
+const tile_t TILE_NONE = 255; // outside the map
+
 typedef struct {
 public:
   std::string name;
@@ -0,0 +1,53 @@
+#ifndef OVERLAY_GRID_HPP
+#define OVERLAY_GRID_HPP
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include "chunked_grid.hpp"
+
+// grid that reads through to a shared base grid, only the cells written
+// through edit are stored, so many of them can share one base
+template <class T>
+class overlay_grid {
+public:
+  overlay_grid() {}
+  explicit overlay_grid(std::shared_ptr<const chunked_grid<T> > base)
+      : _base(base) {}
+
+  int width() const { return _base->width(); }
+  int height() const { return _base->height(); }
+
+  // the value of the base outside the grid
+  const T& operator()(int x, int y) const {
+    if (!_cells.empty() && _base->contains(x, y)) {
+      auto it = _cells.find(index(x, y));
+      if (it != _cells.end()) {
+        return it->second;
+      }
+    }
+    return (*_base)(x, y);
+  }
+
+  // copies the cell from the base the first time it is written, it must be
+  // inside the grid
+  T& edit(int x, int y) {
+    auto it = _cells.find(index(x, y));
+    if (it == _cells.end()) {
+      it = _cells.insert(std::make_pair(index(x, y), (*_base)(x, y))).first;
+    }
+    return it->second;
+  }
+
+  // back to the base
+  void reset() { _cells.clear(); }
+
+private:
+  size_t index(int x, int y) const { return size_t(y) * _base->width() + x; }
+
+  std::shared_ptr<const chunked_grid<T> > _base;
+  std::unordered_map<size_t, T> _cells; // by y * width + x
+};
+
+#endif // OVERLAY_GRID_HPP
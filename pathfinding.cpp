@@ -0,0 +1,483 @@
+#include "pathfinding.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <utility>
+
+using namespace std;
+
+graph_topology::graph_topology(int w, int h, const passable_t& walkable)
+    : _w(w), _h(h), _walkable(walkable) {
+  _edges.assign(w, h);
+  _built.assign(_edges.chunks(), false);
+  _left = _built.size();
+}
+
+void graph_topology::build() const {
+  for (int y = 0; y < _h && _left > 0; y += CHUNK_TILES) {
+    for (int x = 0; x < _w; x += CHUNK_TILES) {
+      if (!_built[chunk_of(x, y)]) {
+        build_chunk(x, y);
+      }
+    }
+  }
+}
+
+void graph_topology::build_chunk(int x, int y) const {
+  _built[chunk_of(x, y)] = true;
+  int x0 = x & ~(CHUNK_TILES - 1);
+  int y0 = y & ~(CHUNK_TILES - 1);
+  int x1 = min(x0 + CHUNK_TILES, _w);
+  int y1 = min(y0 + CHUNK_TILES, _h);
+  for (y = y0; y < y1; ++y) {
+    for (x = x0; x < x1; ++x) {
+      if (!_walkable(x, y)) {
+        continue;
+      }
+      for (int dir = 5; dir < 9; ++dir) {
+        int x2 = x + dir % 3 - 1;
+        int y2 = y + dir / 3 - 1;
+        if (x2 >= 0 && x2 < _w && y2 < _h && _walkable(x2, y2)) {
+          _edges.edit(x, y).slots[dir - 5] = INITIAL_WEIGHT;
+        }
+      }
+    }
+  }
+  // nothing reads the map after the last one
+  if (--_left == 0) {
+    _walkable = nullptr;
+  }
+}
+
+typedef long long dist_t;
+typedef pair<dist_t, size_t> entry_t;
+
+// std::priority_queue based min queue, entries are never updated in place,
+// stale ones are skipped when popped
+class binary_heap {
+public:
+  bool empty() const { return _q.empty(); }
+  void push(dist_t key, size_t value) { _q.push(make_pair(key, value)); }
+  entry_t pop() {
+    entry_t e = _q.top();
+    _q.pop();
+    return e;
+  }
+
+private:
+  priority_queue<entry_t, vector<entry_t>, greater<entry_t> > _q;
+};
+
+// radix heap, only valid for monotone keys (never push a key smaller than the
+// last one popped) which always holds for dijkstra with non-negative weights
+class radix_heap {
+public:
+  radix_heap() : _last(0), _size(0) {}
+  bool empty() const { return _size == 0; }
+  void push(dist_t key, size_t value) {
+    _buckets[bucket(key)].push_back(make_pair(key, value));
+    ++_size;
+  }
+  entry_t pop() {
+    if (_buckets[0].empty()) {
+      // redistribute the first non-empty bucket around its minimum
+      size_t i = 1;
+      while (_buckets[i].empty()) {
+        ++i;
+      }
+      vector<entry_t>& b = _buckets[i];
+      _last = b[0].first;
+      for (size_t j = 1; j < b.size(); ++j) {
+        if (b[j].first < _last) {
+          _last = b[j].first;
+        }
+      }
+      for (size_t j = 0; j < b.size(); ++j) {
+        _buckets[bucket(b[j].first)].push_back(b[j]);
+      }
+      b.clear();
+    }
+    entry_t e = _buckets[0].back();
+    _buckets[0].pop_back();
+    --_size;
+    return e;
+  }
+
+private:
+  dist_t _last;
+  size_t _size;
+  vector<entry_t> _buckets[65];
+
+  size_t bucket(dist_t key) const {
+    unsigned long long diff = (unsigned long long)(key ^ _last);
+    size_t b = 0;
+    while (diff != 0) {
+      ++b;
+      diff >>= 1;
+    }
+    return b;
+  }
+};
+
+// search state of a tile, kept by chunk so a search only pays for the part
+// of the map it reached
+typedef struct {
+  dist_t dist;
+  int8_t from; // direction it was reached from, -1 for the start
+  bool is_visited;
+} dijkstra_node_t;
+
+template <class queue_t>
+bool dijkstra(const graph_t& graph, pos_t start, pos_t dest, int range,
+              deque<pos_t>& path) {
+  // neighbor offsets on the padded grid, edges never point to the border
+  const int stride = graph.stride();
+  int offsets[9];
+  for (int dir = 0; dir < 9; ++dir) {
+    offsets[dir] = (dir / 3 - 1) * stride + dir % 3 - 1;
+  }
+  const dijkstra_node_t unreached = {LLONG_MAX, -1, false};
+  chunked_grid<dijkstra_node_t> nodes;
+  nodes.assign(graph.width(), graph.height(), unreached);
+
+  queue_t q;
+  size_t cur = graph.index(start.x, start.y);
+  nodes.edit(start.x, start.y).dist = 0;
+  q.push(0, cur);
+  bool found = false;
+  while (!q.empty()) {
+    entry_t e = q.pop();
+    cur = e.second;
+    int x = graph.x_of(cur);
+    int y = graph.y_of(cur);
+    dijkstra_node_t& node = nodes.edit(x, y);
+    if (node.is_visited || e.first > node.dist) {
+      continue;
+    }
+    node.is_visited = true;
+
+    if (in_range(x - dest.x, y - dest.y, range)) {
+      found = true;
+      break;
+    }
+
+    // relax neighbors, the edges towards r, dl, d and dr are stored in the
+    // tile and the others in the neighbor they lead to
+    const tile_edges_t& edges = graph.tile(x, y);
+    for (int dir = 0; dir < 9; ++dir) {
+      if (dir == 4) {
+        continue;
+      }
+      weight_t weight = dir > 4 ? edges.slots[dir - 5]
+                                : graph.weight(x, y, dir);
+      if (weight == NO_EDGE) {
+        continue;
+      }
+      dijkstra_node_t& next = nodes.edit(x + dir % 3 - 1, y + dir / 3 - 1);
+      dist_t d = node.dist + weight;
+      if (!next.is_visited && d < next.dist) {
+        next.dist = d;
+        next.from = int8_t(8 - dir);
+        q.push(d, cur + offsets[dir]);
+      }
+    }
+  }
+
+  // backpropagate path
+  path.clear();
+  if (!found) {
+    return false;
+  }
+  pos_t p = {graph.x_of(cur), graph.y_of(cur)};
+  for (int dir = nodes(p.x, p.y).from; dir >= 0; dir = nodes(p.x, p.y).from) {
+    path.push_front(p);
+    p.x += dir % 3 - 1;
+    p.y += dir / 3 - 1;
+  }
+  return true;
+}
+
+bool dijkstra(const graph_t& graph, pos_t start, pos_t dest, int range,
+              deque<pos_t>& path, queue_type queue) {
+  if (queue == BINARY_HEAP) {
+    return dijkstra<binary_heap>(graph, start, dest, range, path);
+  }
+  return dijkstra<radix_heap>(graph, start, dest, range, path);
+}
+
+int octile(int dx, int dy) {
+  return dx > dy ? STRAIGHT_COST * dx + (DIAGONAL_COST - STRAIGHT_COST) * dy
+                 : STRAIGHT_COST * dy + (DIAGONAL_COST - STRAIGHT_COST) * dx;
+}
+
+int chebyshev(int dx, int dy) {
+  return STRAIGHT_COST * max(dx, dy);
+}
+
+// not admissible with diagonal moves, finds paths faster but not the shortest
+int manhattan(int dx, int dy) {
+  return STRAIGHT_COST * (dx + dy);
+}
+
+int zero(int, int) {
+  return 0;
+}
+
+int sign(int x) {
+  return (x > 0) - (x < 0);
+}
+
+const size_t path_finder::NO_TILE;
+
+path_finder::path_finder()
+  : _w(0), _h(0), _range(0), _passable(NULL), _generation(0), _expanded(0) {
+  _dest.x = 0;
+  _dest.y = 0;
+}
+
+bool path_finder::astar(int w, int h, const passable_t& passable,
+                        pos_t start, pos_t dest, int range,
+                        deque<pos_t>& path, heuristic_t heuristic) {
+  reset(w, h, passable, dest, range);
+  path.clear();
+  size_t s = size_t(start.y) * w + start.x;
+  open(s, 0, NO_TILE, goal_dist(start.x, start.y, heuristic));
+  while (!_open.empty()) {
+    pop_heap(_open.begin(), _open.end(), greater<entry_t>());
+    size_t tile = _open.back().second;
+    _open.pop_back();
+    if (_closed[tile] == _generation) {
+      continue;
+    }
+    _closed[tile] = _generation;
+    ++_expanded;
+
+    int x = int(tile % w);
+    int y = int(tile / w);
+    if (is_goal(x, y)) {
+      build_path(tile, path);
+      return true;
+    }
+    for (int dir = 0; dir < 9; ++dir) {
+      int dx = dir % 3 - 1;
+      int dy = dir / 3 - 1;
+      int x1 = x + dx;
+      int y1 = y + dy;
+      size_t next = size_t(y1) * w + x1;
+      if (dir == 4 || !can_enter(x1, y1) || _closed[next] == _generation) {
+        continue;
+      }
+      int g = _g[tile] + (dx != 0 && dy != 0 ? DIAGONAL_COST : STRAIGHT_COST);
+      open(next, g, tile, g + goal_dist(x1, y1, heuristic));
+    }
+  }
+  return false;
+}
+
+bool path_finder::jps(int w, int h, const passable_t& passable, pos_t start,
+                      pos_t dest, int range, deque<pos_t>& path) {
+  reset(w, h, passable, dest, range);
+  path.clear();
+  size_t s = size_t(start.y) * w + start.x;
+  open(s, 0, NO_TILE, goal_dist(start.x, start.y, octile));
+  while (!_open.empty()) {
+    pop_heap(_open.begin(), _open.end(), greater<entry_t>());
+    size_t tile = _open.back().second;
+    _open.pop_back();
+    if (_closed[tile] == _generation) {
+      continue;
+    }
+    _closed[tile] = _generation;
+    ++_expanded;
+
+    int x = int(tile % w);
+    int y = int(tile / w);
+    if (is_goal(x, y)) {
+      build_path(tile, path);
+      return true;
+    }
+
+    // prune neighbors by the direction we came from
+    int dirs[8][2];
+    int n = 0;
+    if (_parent[tile] == NO_TILE) {
+      for (int dir = 0; dir < 9; ++dir) {
+        if (dir != 4) {
+          dirs[n][0] = dir % 3 - 1;
+          dirs[n][1] = dir / 3 - 1;
+          ++n;
+        }
+      }
+    } else {
+      int dx = sign(x - int(_parent[tile] % w));
+      int dy = sign(y - int(_parent[tile] / w));
+      if (dx != 0 && dy != 0) {
+        int natural[3][2] = {{dx, 0}, {0, dy}, {dx, dy}};
+        for (int i = 0; i < 3; ++i, ++n) {
+          dirs[n][0] = natural[i][0];
+          dirs[n][1] = natural[i][1];
+        }
+        if (!can_enter(x - dx, y)) {
+          dirs[n][0] = -dx;
+          dirs[n][1] = dy;
+          ++n;
+        }
+        if (!can_enter(x, y - dy)) {
+          dirs[n][0] = dx;
+          dirs[n][1] = -dy;
+          ++n;
+        }
+      } else {
+        // straight move, forced neighbors are the diagonals past a blocked
+        // side tile
+        int sx = dy != 0; // side direction
+        int sy = dx != 0;
+        dirs[n][0] = dx;
+        dirs[n][1] = dy;
+        ++n;
+        if (!can_enter(x + sx, y + sy)) {
+          dirs[n][0] = dx + sx;
+          dirs[n][1] = dy + sy;
+          ++n;
+        }
+        if (!can_enter(x - sx, y - sy)) {
+          dirs[n][0] = dx - sx;
+          dirs[n][1] = dy - sy;
+          ++n;
+        }
+      }
+    }
+
+    for (int i = 0; i < n; ++i) {
+      int jx, jy;
+      if (!jump(x, y, dirs[i][0], dirs[i][1], jx, jy)) {
+        continue;
+      }
+      size_t next = size_t(jy) * w + jx;
+      if (_closed[next] == _generation) {
+        continue;
+      }
+      int g = _g[tile] + octile(abs(jx - x), abs(jy - y));
+      open(next, g, tile, g + goal_dist(jx, jy, octile));
+    }
+  }
+  return false;
+}
+
+size_t path_finder::expanded() const {
+  return _expanded;
+}
+
+void path_finder::reset(int w, int h, const passable_t& passable,
+                        pos_t dest, int range) {
+  size_t size = size_t(w) * h;
+  if (_stamp.size() != size) {
+    _stamp.assign(size, 0);
+    _g.resize(size);
+    _parent.resize(size);
+    _closed.assign(size, 0);
+    _generation = 0;
+  }
+  // stamps tell which tiles belong to the current query, so nothing needs to
+  // be cleared between queries
+  ++_generation;
+  if (_generation == 0) {
+    fill(_stamp.begin(), _stamp.end(), 0);
+    fill(_closed.begin(), _closed.end(), 0);
+    _generation = 1;
+  }
+  _w = w;
+  _h = h;
+  _passable = &passable;
+  _dest = dest;
+  _range = range;
+  _open.clear();
+  _expanded = 0;
+}
+
+bool path_finder::can_enter(int x, int y) const {
+  return x >= 0 && x < _w && y >= 0 && y < _h && (*_passable)(x, y);
+}
+
+bool path_finder::is_goal(int x, int y) const {
+  return abs(x - _dest.x) <= _range && abs(y - _dest.y) <= _range;
+}
+
+int path_finder::goal_dist(int x, int y, heuristic_t heuristic) const {
+  int dx = max(0, abs(x - _dest.x) - _range);
+  int dy = max(0, abs(y - _dest.y) - _range);
+  return heuristic(dx, dy);
+}
+
+// moves from x, y in one direction until a tile worth expanding is found
+bool path_finder::jump(int x, int y, int dx, int dy, int& jx, int& jy) const {
+  while (true) {
+    x += dx;
+    y += dy;
+    if (!can_enter(x, y)) {
+      return false;
+    }
+    jx = x;
+    jy = y;
+    if (is_goal(x, y)) {
+      return true;
+    }
+    if (dx != 0 && dy != 0) {
+      if ((!can_enter(x - dx, y) && can_enter(x - dx, y + dy)) ||
+          (!can_enter(x, y - dy) && can_enter(x + dx, y - dy))) {
+        return true;
+      }
+      int tx, ty;
+      if (jump(x, y, dx, 0, tx, ty) || jump(x, y, 0, dy, tx, ty)) {
+        return true;
+      }
+    } else if (dx != 0) {
+      if ((!can_enter(x, y + 1) && can_enter(x + dx, y + 1)) ||
+          (!can_enter(x, y - 1) && can_enter(x + dx, y - 1))) {
+        return true;
+      }
+    } else {
+      if ((!can_enter(x + 1, y) && can_enter(x + 1, y + dy)) ||
+          (!can_enter(x - 1, y) && can_enter(x - 1, y + dy))) {
+        return true;
+      }
+    }
+  }
+}
+
+void path_finder::open(size_t tile, int g, size_t parent, int f) {
+  if (_stamp[tile] == _generation && _g[tile] <= g) {
+    return;
+  }
+  _stamp[tile] = _generation;
+  _g[tile] = g;
+  _parent[tile] = parent;
+  _open.push_back(make_pair(f, tile));
+  push_heap(_open.begin(), _open.end(), greater<entry_t>());
+}
+
+void path_finder::build_path(size_t tile, deque<pos_t>& path) const {
+  // jump points can be several tiles apart, fill in the tiles between them
+  while (_parent[tile] != NO_TILE) {
+    size_t parent = _parent[tile];
+    int x = int(tile % _w);
+    int y = int(tile / _w);
+    int px = int(parent % _w);
+    int py = int(parent / _w);
+    int dx = sign(px - x);
+    int dy = sign(py - y);
+    while (x != px || y != py) {
+      pos_t p;
+      p.x = x;
+      p.y = y;
+      path.push_front(p);
+      x += dx;
+      y += dy;
+    }
+    tile = parent;
+  }
+}
@@ -0,0 +1,355 @@
+#ifndef PATHFINDING_HPP
+#define PATHFINDING_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "chunked_grid.hpp"
+#include "grid.hpp"
+
+typedef struct {
+  int x;
+  int y;
+} pos_t;
+
+// true if the tile can be entered, only called for tiles inside the map
+typedef std::function<bool(int x, int y)> passable_t;
+
+// edge weight of the learned graph
+typedef uint16_t weight_t;
+const weight_t NO_EDGE = 0;
+const weight_t MIN_WEIGHT = 1;
+const weight_t MAX_WEIGHT = UINT16_MAX;
+const weight_t INITIAL_WEIGHT = 0x8000;
+
+// high intelligence AI, directions from a tile
+//  +---+---+---+   +---+---+---+
+//  |ul | u |ur |   | 0 | 1 | 2 |
+//  +---+---+---+   +---+---+---+
+//  | l | X | r |   | 3 | X | 5 |
+//  +---+---+---+   +---+---+---+
+//  |dl | d |dr |   | 6 | 7 | 8 |
+//  +---+---+---+   +---+---+---+
+// edges go both ways and are stored once, in the tile they leave towards
+// r, dl, d or dr
+typedef struct {
+  weight_t slots[4]; // r, dl, d, dr
+} tile_edges_t;
+
+// the edges of a map before any learning, built a chunk of tiles at a time
+// the first time one of them is read, so a big map only pays for the part
+// its AIs went through
+// building reads the map, so only the main thread reads a topology until
+// build is called, it never changes after that and every AI on the same
+// map can share it from any thread
+class graph_topology {
+public:
+  typedef chunked_grid<tile_edges_t> edges_grid_t;
+  static const int CHUNK_BITS = edges_grid_t::CHUNK_BITS;
+  static const int CHUNK_TILES = edges_grid_t::CHUNK_TILES;
+
+  // every edge between walkable neighbors starts with INITIAL_WEIGHT
+  graph_topology(int w, int h, const passable_t& walkable);
+
+  int width() const { return _w; }
+  int height() const { return _h; }
+  bool contains(int x, int y) const { return _edges.contains(x, y); }
+
+  // tiles by linear index, like grid, the one tile border has no edges
+  int stride() const { return _w + 2; }
+  size_t size() const { return size_t(_w + 2) * (_h + 2); }
+  size_t index(int x, int y) const { return size_t(y + 1) * stride() + x + 1; }
+  int x_of(size_t index) const { return int(index % stride()) - 1; }
+  int y_of(size_t index) const { return int(index / stride()) - 1; }
+
+  // storage slot of the edge leaving a tile in a direction (not 4), both
+  // ends of an edge give the same slot
+  size_t edge(size_t index, int dir) const {
+    if (dir > 4) {
+      return index * 4 + dir - 5;
+    }
+    return (index + (dir / 3 - 1) * stride() + dir % 3 - 1) * 4 + 3 - dir;
+  }
+  size_t edges() const { return size() * 4; }
+  // moves x, y to the tile storing the edge leaving it in a direction (not
+  // 4) and returns the slot of the edge there
+  static int slot(int& x, int& y, int dir) {
+    if (dir > 4) {
+      return dir - 5;
+    }
+    x += dir % 3 - 1;
+    y += dir / 3 - 1;
+    return 3 - dir;
+  }
+
+  // true if the edge leaving a tile in a direction (not 4) exists, which
+  // means both tiles are walkable
+  bool has_edge(int x, int y, int dir) const {
+    int s = slot(x, y, dir);
+    return tile(x, y).slots[s] != NO_EDGE;
+  }
+
+  // chunks of tiles, like chunked_grid
+  size_t chunks() const { return _edges.chunks(); }
+  size_t chunk_of(int x, int y) const { return _edges.chunk_of(x, y); }
+  static size_t cell_of(int x, int y) { return edges_grid_t::cell_of(x, y); }
+
+  // edges stored in a tile, none outside the map
+  const tile_edges_t& tile(int x, int y) const {
+    if (contains(x, y) && !_built[chunk_of(x, y)]) {
+      build_chunk(x, y);
+    }
+    return _edges(x, y);
+  }
+  // builds the chunks no one read yet
+  void build() const;
+
+private:
+  void build_chunk(int x, int y) const; // of the tile
+
+  int _w;
+  int _h;
+  mutable passable_t _walkable; // until every chunk is built
+  mutable edges_grid_t _edges; // chunks without edges are never allocated
+  mutable std::vector<bool> _built; // by chunk
+  mutable size_t _left; // chunks not built yet
+};
+
+// what one AI learned on top of a shared topology, the weights and visited
+// tiles of a chunk of the topology are copied the first time the AI changes
+// one of them, so an AI only pays for the part of the map it walked on
+// weights saturate instead of wrapping around
+class learned_graph {
+public:
+  static const int CHUNK_TILES = graph_topology::CHUNK_TILES;
+
+  learned_graph() {}
+  explicit learned_graph(std::shared_ptr<const graph_topology> topology)
+      : _topology(topology) {}
+
+  // with a topology of its own
+  void assign(int w, int h, const passable_t& walkable) {
+    _topology = std::make_shared<graph_topology>(w, h, walkable);
+    _weights.clear();
+    _visited.clear();
+  }
+  // moves what was learned onto the topology of the map after it changed,
+  // edges into new walls are dropped and new edges start untrained
+  void rebase(std::shared_ptr<const graph_topology> topology) {
+    std::shared_ptr<const graph_topology> old = _topology;
+    _topology = topology;
+    if (!old || old->width() != width() || old->height() != height()) {
+      _weights.clear();
+      _visited.clear();
+      return;
+    }
+    for (int y0 = 0; y0 < height(); y0 += CHUNK_TILES) {
+      for (int x0 = 0; x0 < width(); x0 += CHUNK_TILES) {
+        size_t chunk = _topology->chunk_of(x0, y0);
+        if (chunk >= _weights.size() || _weights[chunk].empty()) {
+          continue;
+        }
+        int x1 = std::min(x0 + CHUNK_TILES, width());
+        int y1 = std::min(y0 + CHUNK_TILES, height());
+        for (int y = y0; y < y1; ++y) {
+          for (int x = x0; x < x1; ++x) {
+            tile_edges_t& learned =
+                _weights[chunk][graph_topology::cell_of(x, y)];
+            const tile_edges_t& edges = _topology->tile(x, y);
+            for (int slot = 0; slot < 4; ++slot) {
+              if (edges.slots[slot] == NO_EDGE ||
+                  learned.slots[slot] == NO_EDGE) {
+                learned.slots[slot] = edges.slots[slot];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  const graph_topology& topology() const { return *_topology; }
+  int width() const { return _topology->width(); }
+  int height() const { return _topology->height(); }
+  int stride() const { return _topology->stride(); }
+  size_t size() const { return _topology->size(); }
+  size_t index(int x, int y) const { return _topology->index(x, y); }
+  int x_of(size_t index) const { return _topology->x_of(index); }
+  int y_of(size_t index) const { return _topology->y_of(index); }
+  size_t edge(size_t index, int dir) const {
+    return _topology->edge(index, dir);
+  }
+  size_t edge(int x, int y, int dir) const { return edge(index(x, y), dir); }
+  size_t edges() const { return _topology->edges(); }
+
+  // edges stored in a tile, none outside the map
+  const tile_edges_t& tile(int x, int y) const {
+    if (_topology->contains(x, y)) {
+      size_t chunk = _topology->chunk_of(x, y);
+      if (chunk < _weights.size() && !_weights[chunk].empty()) {
+        return _weights[chunk][graph_topology::cell_of(x, y)];
+      }
+    }
+    return _topology->tile(x, y);
+  }
+  weight_t weight(size_t edge) const {
+    return tile(x_of(edge / 4), y_of(edge / 4)).slots[edge % 4];
+  }
+  weight_t weight(int x, int y, int dir) const {
+    int slot = graph_topology::slot(x, y, dir);
+    return tile(x, y).slots[slot];
+  }
+  // adds to the weight of an edge, between MIN_WEIGHT and MAX_WEIGHT
+  void learn(size_t edge, int delta) {
+    learn_slot(x_of(edge / 4), y_of(edge / 4), edge % 4, delta);
+  }
+  void learn(int x, int y, int dir, int delta) {
+    int slot = graph_topology::slot(x, y, dir);
+    learn_slot(x, y, slot, delta);
+  }
+
+  // tiles the AI has walked on
+  bool visited(int x, int y) const {
+    if (!_topology->contains(x, y)) {
+      return false;
+    }
+    size_t chunk = _topology->chunk_of(x, y);
+    return chunk < _visited.size() && !_visited[chunk].empty() &&
+           _visited[chunk][graph_topology::cell_of(x, y)];
+  }
+  bool visited(size_t index) const {
+    return visited(x_of(index), y_of(index));
+  }
+  void set_visited(int x, int y) {
+    size_t chunk = _topology->chunk_of(x, y);
+    if (_visited.empty()) {
+      _visited.resize(_topology->chunks());
+    }
+    if (_visited[chunk].empty()) {
+      _visited[chunk].assign(CHUNK_TILES * CHUNK_TILES, false);
+    }
+    _visited[chunk][graph_topology::cell_of(x, y)] = true;
+  }
+  void set_visited(size_t index) { set_visited(x_of(index), y_of(index)); }
+
+private:
+  void learn_slot(int x, int y, int slot, int delta) {
+    if (_topology->tile(x, y).slots[slot] == NO_EDGE) {
+      return;
+    }
+    weight_t& w = weight_chunk(x, y)[graph_topology::cell_of(x, y)]
+                      .slots[slot];
+    int sum = w + delta;
+    w = sum < MIN_WEIGHT ? MIN_WEIGHT : sum > MAX_WEIGHT ? MAX_WEIGHT : sum;
+  }
+  // the weights of the chunk of a tile, copied from the topology the first
+  // time
+  std::vector<tile_edges_t>& weight_chunk(int x, int y) {
+    if (_weights.empty()) {
+      _weights.resize(_topology->chunks());
+    }
+    std::vector<tile_edges_t>& weights = _weights[_topology->chunk_of(x, y)];
+    if (weights.empty()) {
+      weights.resize(CHUNK_TILES * CHUNK_TILES);
+      int x0 = x & ~(CHUNK_TILES - 1);
+      int y0 = y & ~(CHUNK_TILES - 1);
+      int x1 = std::min(x0 + CHUNK_TILES, width());
+      int y1 = std::min(y0 + CHUNK_TILES, height());
+      for (y = y0; y < y1; ++y) {
+        for (x = x0; x < x1; ++x) {
+          weights[graph_topology::cell_of(x, y)] = _topology->tile(x, y);
+        }
+      }
+    }
+    return weights;
+  }
+
+  std::shared_ptr<const graph_topology> _topology;
+  // by chunk, empty until learned or visited
+  std::vector<std::vector<tile_edges_t> > _weights;
+  std::vector<std::vector<bool> > _visited;
+};
+typedef learned_graph graph_t;
+
+enum queue_type {
+  BINARY_HEAP, // std::priority_queue with lazy deletion
+  RADIX_HEAP   // monotone integer radix heap
+};
+
+// whether dx, dy tiles away is within attack range, same as rounding the
+// euclidean distance and comparing it to range, without the square root:
+// d <= r + 0.5 means dx^2 + dy^2 <= r^2 + r + 0.25
+inline bool in_range(int dx, int dy, int range) {
+  return int64_t(dx) * dx + int64_t(dy) * dy <=
+         int64_t(range) * range + range;
+}
+
+// dijkstra's shortest path over the learned edge weights from start to the
+// first cell in_range of dest, where it can attack from, path gets the cells
+// to walk excluding start, returns false if dest can't be reached
+bool dijkstra(const graph_t& graph, pos_t start, pos_t dest, int range,
+              std::deque<pos_t>& path, queue_type queue = BINARY_HEAP);
+
+// grid movement costs, diagonals alternate between 1 and 2 moves in
+// Game::move so they average 1.5 straight moves
+const int STRAIGHT_COST = 2;
+const int DIAGONAL_COST = 3;
+
+// estimated cost to move dx, dy tiles
+typedef int (*heuristic_t)(int dx, int dy);
+int octile(int dx, int dy);
+int chebyshev(int dx, int dy);
+int manhattan(int dx, int dy);
+int zero(int dx, int dy); // plain dijkstra
+
+// goal directed searches on a uniform cost grid, they keep their buffers
+// between queries so repeated searches on the same map don't allocate
+class path_finder {
+public:
+  path_finder();
+
+  // A* from start to the first tile within range of dest (square range)
+  bool astar(int w, int h, const passable_t& passable, pos_t start,
+             pos_t dest, int range, std::deque<pos_t>& path,
+             heuristic_t heuristic = octile);
+  // jump point search, finds paths as short as astar with the octile
+  // heuristic but expands far less tiles on open areas
+  bool jps(int w, int h, const passable_t& passable, pos_t start,
+           pos_t dest, int range, std::deque<pos_t>& path);
+  // tiles expanded by the last query
+  size_t expanded() const;
+
+private:
+  static const size_t NO_TILE = size_t(-1);
+
+  // tiles are y * w + x
+  typedef std::pair<int, size_t> entry_t; // (f, tile)
+
+  int _w;
+  int _h;
+  int _range;
+  pos_t _dest;
+  const passable_t* _passable;
+  unsigned _generation;
+  std::vector<unsigned> _stamp;
+  std::vector<int> _g;
+  std::vector<size_t> _parent; // NO_TILE for the start
+  std::vector<unsigned> _closed;
+  std::vector<entry_t> _open;
+  size_t _expanded;
+
+  void reset(int w, int h, const passable_t& passable, pos_t dest,
+             int range);
+  bool can_enter(int x, int y) const;
+  bool is_goal(int x, int y) const;
+  int goal_dist(int x, int y, heuristic_t heuristic) const;
+  bool jump(int x, int y, int dx, int dy, int& jx, int& jy) const;
+  void open(size_t tile, int g, size_t parent, int f);
+  void build_path(size_t tile, std::deque<pos_t>& path) const;
+};
+
+#endif // PATHFINDING_HPP
@@ -0,0 +1,66 @@
+#ifndef RNG_HPP
+#define RNG_HPP
+
+#include <cstdint>
+#include <utility>
+
+// xoshiro128** pseudo random generator, small and fast, the same seed always
+// gives the same numbers on every platform
+class rng {
+public:
+  explicit rng(uint64_t seed = 0) { reseed(seed); }
+
+  // the state is expanded from the seed with splitmix64
+  void reseed(uint64_t seed) {
+    for (int i = 0; i < 4; i += 2) {
+      uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      z ^= z >> 31;
+      _s[i] = uint32_t(z);
+      _s[i + 1] = uint32_t(z >> 32);
+    }
+  }
+
+  uint32_t next() {
+    uint32_t result = rotl(_s[1] * 5, 7) * 9;
+    uint32_t t = _s[1] << 9;
+    _s[2] ^= _s[0];
+    _s[3] ^= _s[1];
+    _s[1] ^= _s[2];
+    _s[0] ^= _s[3];
+    _s[2] ^= t;
+    _s[3] = rotl(_s[3], 11);
+    return result;
+  }
+
+  // number in [0, n), n must be greater than 0
+  int roll(int n) { return int((uint64_t(next()) * uint32_t(n)) >> 32); }
+
+  // fisher-yates, std::shuffle is not the same on every standard library
+  template <class It>
+  void shuffle(It first, It last) {
+    for (int i = int(last - first) - 1; i > 0; --i) {
+      std::swap(first[i], first[roll(i + 1)]);
+    }
+  }
+
+private:
+  static uint32_t rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+  uint32_t _s[4];
+};
+
+// mixes two coordinates and a seed into a random looking number without any
+// state, used for things that must look the same on every frame
+inline uint32_t hash_tile(int x, int y, uint32_t seed = 0) {
+  uint32_t h = seed ^ (uint32_t(x) * 0x9e3779b1u) ^ (uint32_t(y) * 0x85ebca77u);
+  h ^= h >> 15;
+  h *= 0x2c1b3c6du;
+  h ^= h >> 12;
+  h *= 0x297a2d39u;
+  h ^= h >> 15;
+  return h;
+}
+
+#endif // RNG_HPP
@@ -0,0 +1,259 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+#include "config.hpp"
+#include "ai.hpp"
+#include "game.hpp"
+#include "pathfinding.hpp"
+
+using namespace std;
+
+const string MATERIALS_FILENAME = "assets/materials";
+const string MAP_FILENAME = "assets/map_fortaleza";
+const string CHARACTERS_FILENAME = "assets/characters";
+const string ENEMIES_FILENAME = "assets/enemies";
+
+#ifdef _WIN32
+const char* NULL_DEVICE = "NUL";
+#else
+const char* NULL_DEVICE = "/dev/null";
+#endif
+
+extern int g_ai_update;
+extern int g_dijkstra_speed;
+extern int HIGH_AI_TOTAL_ITERATIONS;
+extern int g_ai_threads;
+extern int g_ai_trainers;
+
+typedef struct {
+  string map_file;
+  int battles;
+  int enemies;
+  int enemy_type; // -1 for a random mix
+  size_t max_turns; // per battle
+  unsigned long long seed; // of the first battle, the next ones add one
+  bool verbose;
+} options_t;
+
+path_finder g_player_path_finder;
+
+void usage(const char* name) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -m FILE  map file (default %s)\n"
+          "  -b N     number of battles (default 100)\n"
+          "  -e N     enemies per battle (default 5)\n"
+          "  -t N     enemy type, index in %s (default random)\n"
+          "  -r N     maximum turns per battle (default 1000)\n"
+          "  -i N     high intelligence AI training iterations (default %d)\n"
+          "  -s N     random seed (default current time)\n"
+          "  -j N     AI training threads (default one per core)\n"
+          "  -w N     AI training walk streams, up to one thread each, the\n"
+          "           results depend on them and not on -j (default %d)\n"
+          "  -v       print the game log\n",
+          name, MAP_FILENAME.c_str(), ENEMIES_FILENAME.c_str(),
+          HIGH_AI_TOTAL_ITERATIONS, g_ai_trainers);
+}
+
+bool parse_options(int argc, char** argv, options_t& opt) {
+  opt.map_file = MAP_FILENAME;
+  opt.battles = 100;
+  opt.enemies = 5;
+  opt.enemy_type = -1;
+  opt.max_turns = 1000;
+  opt.seed = time(0);
+  opt.verbose = false;
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (strcmp(arg, "-v") == 0) {
+      opt.verbose = true;
+      continue;
+    }
+    if (i + 1 >= argc || strlen(arg) != 2 || arg[0] != '-') {
+      return false;
+    }
+    const char* value = argv[++i];
+    switch (arg[1]) {
+      case 'm':
+        opt.map_file = value;
+        break;
+      case 'b':
+        opt.battles = atoi(value);
+        break;
+      case 'e':
+        opt.enemies = atoi(value);
+        break;
+      case 't':
+        opt.enemy_type = atoi(value);
+        break;
+      case 'r':
+        opt.max_turns = atoi(value);
+        break;
+      case 'i':
+        HIGH_AI_TOTAL_ITERATIONS = atoi(value);
+        break;
+      case 's':
+        opt.seed = strtoull(value, NULL, 10);
+        break;
+      case 'j':
+        g_ai_threads = atoi(value);
+        break;
+      case 'w':
+        g_ai_trainers = atoi(value);
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+void spawn_enemies(Game& g, const options_t& opt) {
+  int w = g.map.width();
+  int h = g.map.height();
+  for (int i = 0; i < opt.enemies; ++i) {
+    int type = opt.enemy_type;
+    if (type < 0 || type >= int(g.enemies.size())) {
+      type = g.dice.roll(g.enemies.size());
+    }
+    // give up on crowded maps
+    for (int tries = 0; tries < w * h; ++tries) {
+      int x = g.dice.roll(w);
+      int y = g.dice.roll(h);
+      if (g.is_walkable(x, y) && !g.is_tile_occupied(x, y)) {
+        g.create_enemy(type, x, y);
+        break;
+      }
+    }
+  }
+}
+
+// playable characters attack whatever is in range, otherwise they walk
+// towards the nearest enemy
+void play_turn(Game& g) {
+  vector<character_handle> list = g.attack_range();
+  if (!list.empty()) {
+    g.attack(list[g.dice.roll(list.size())]);
+    g.end_turn();
+    return;
+  }
+
+  const character& ch = g.characters[g.turns.current()];
+  const character* nearest = &ch;
+  int64_t min_dist = -1;
+  for (size_t i = 0; i < g.characters.size(); ++i) {
+    const character& ch2 = g.characters.dense(i);
+    if (ch2.is_playable == ch.is_playable) {
+      continue;
+    }
+    int64_t dx = ch2.pos.x - ch.pos.x;
+    int64_t dy = ch2.pos.y - ch.pos.y;
+    if (min_dist < 0 || dx * dx + dy * dy < min_dist) {
+      nearest = &ch2;
+      min_dist = dx * dx + dy * dy;
+    }
+  }
+  pos_t start = {ch.pos.x, ch.pos.y};
+  pos_t dest = {nearest->pos.x, nearest->pos.y};
+  deque<pos_t> path;
+  g_player_path_finder.jps(g.map.width(), g.map.height(),
+                           [&g](int x, int y) {
+                             return g.is_walkable(x, y) &&
+                                    !g.is_tile_occupied(x, y);
+                           },
+                           start, dest, ch.range, path);
+  if (path.empty() || !g.move(path[0].x - ch.pos.x, path[0].y - ch.pos.y) ||
+      g.move_limit == 0) {
+    g.end_turn();
+  }
+}
+
+// 0 while fighting, 1 if playable characters won, 2 if enemies won
+int winner(const Game& g) {
+  bool players = false;
+  bool enemies = false;
+  for (size_t i = 0; i < g.characters.size(); ++i) {
+    players |= g.characters.dense(i).is_playable;
+    enemies |= !g.characters.dense(i).is_playable;
+  }
+  if (players && enemies) {
+    return 0;
+  }
+  return players ? 1 : 2;
+}
+
+int main(int argc, char** argv) {
+  options_t opt;
+  if (!parse_options(argc, argv, opt)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  fprintf(stderr, "Dungeon Master simulator v%d.%d\n", VERSION_MAJOR,
+          VERSION_MINOR);
+  if (!opt.verbose) {
+    // the game logs to stdout, the results go to stderr
+    if (freopen(NULL_DEVICE, "w", stdout) == NULL) {
+      fprintf(stderr, "Error opening file: %s\n", NULL_DEVICE);
+    }
+  }
+
+  // run the AI as fast as possible, without stopping to draw steps
+  g_ai_update = 0;
+  g_dijkstra_speed = 0;
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  size_t total_turns = 0;
+  size_t total_rounds = 0;
+  int wins[3] = {0, 0, 0};
+  for (int battle = 0; battle < opt.battles; ++battle) {
+    Game g([](const string&) { return size_t(0); }, MATERIALS_FILENAME,
+           opt.map_file, CHARACTERS_FILENAME, ENEMIES_FILENAME,
+           opt.seed + battle);
+    spawn_enemies(g, opt);
+
+    // characters that can't reach anyone would never end their turn
+    const int max_ticks = 4 * (g.map.width() + g.map.height());
+    size_t last_turn = g.turn;
+    int ticks = 0;
+    while (winner(g) == 0 && g.turn < opt.max_turns) {
+      if (is_ai_thinking(g)) {
+        this_thread::yield();
+        process_ai(g);
+        continue;
+      }
+      if (g.characters[g.turns.current()].is_playable) {
+        play_turn(g);
+      } else {
+        process_ai(g);
+      }
+      if (g.turn != last_turn) {
+        last_turn = g.turn;
+        ticks = 0;
+      } else if (++ticks >= max_ticks) {
+        g.end_turn();
+      }
+    }
+    ++wins[winner(g)];
+    total_turns += g.turn;
+    total_rounds += g.turns.round();
+  }
+  double secs =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  fprintf(stderr, "Map: %s\n", opt.map_file.c_str());
+  fprintf(stderr, "Seed: %llu\n", opt.seed);
+  fprintf(stderr, "Battles: %d (players won %d, enemies won %d, "
+          "unfinished %d)\n", opt.battles, wins[1], wins[2], wins[0]);
+  fprintf(stderr, "Turns: %zu\n", total_turns);
+  fprintf(stderr, "Rounds: %zu\n", total_rounds);
+  fprintf(stderr, "Time: %.3f s\n", secs);
+  fprintf(stderr, "Throughput: %.1f battles/s, %.1f rounds/s, %.1f turns/s\n",
+          opt.battles / secs, total_rounds / secs, total_turns / secs);
+  return EXIT_SUCCESS;
+}
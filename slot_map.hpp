@@ -0,0 +1,122 @@
+#ifndef SLOT_MAP_HPP
+#define SLOT_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+// stable reference to an item of a slot_map, the slot in the low bits and
+// its generation in the high bits so handles of erased items never match
+// the item that reuses the slot
+typedef uint32_t slot_handle;
+const slot_handle NO_HANDLE = 0; // never given out
+const int SLOT_BITS = 20;
+
+// index of the slot, for tables that live next to a slot_map
+inline uint32_t slot_of(slot_handle handle) {
+  return handle & ((1u << SLOT_BITS) - 1);
+}
+
+// items stored contiguously, inserted and erased in O(1) through handles
+// that stay valid until the item is erased, erasing moves the last item into
+// the hole so the iteration order changes
+template <class T>
+class slot_map {
+public:
+  typedef typename std::vector<T>::iterator iterator;
+  typedef typename std::vector<T>::const_iterator const_iterator;
+
+  slot_handle insert(T item) {
+    uint32_t slot;
+    if (_free.empty()) {
+      slot = _slots.size();
+      if (slot > SLOT_MASK) {
+        fprintf(stderr, "Error: slot map full\n");
+        exit(EXIT_FAILURE);
+      }
+      _slots.push_back(make_slot(1));
+    } else {
+      slot = _free.back();
+      _free.pop_back();
+    }
+    _slots[slot].dense = _items.size();
+    _items.push_back(std::move(item));
+    slot_handle handle = _slots[slot].generation << SLOT_BITS | slot;
+    _handles.push_back(handle);
+    return handle;
+  }
+
+  void erase(slot_handle handle) {
+    if (!contains(handle)) {
+      return;
+    }
+    slot_t& s = _slots[handle & SLOT_MASK];
+    if (s.dense + 1 < _items.size()) {
+      _items[s.dense] = std::move(_items.back());
+      _handles[s.dense] = _handles.back();
+      _slots[_handles[s.dense] & SLOT_MASK].dense = s.dense;
+    }
+    _items.pop_back();
+    _handles.pop_back();
+    // generation 0 would make handle 0 valid
+    s.generation = s.generation + 1 < GENERATIONS ? s.generation + 1 : 1;
+    _free.push_back(handle & SLOT_MASK);
+  }
+
+  void clear() {
+    for (size_t i = _handles.size(); i-- > 0;) {
+      erase(_handles[i]);
+    }
+  }
+
+  bool contains(slot_handle handle) const {
+    uint32_t slot = handle & SLOT_MASK;
+    return slot < _slots.size() &&
+           _slots[slot].generation == handle >> SLOT_BITS &&
+           _slots[slot].dense < _items.size() &&
+           _handles[_slots[slot].dense] == handle;
+  }
+
+  // the handle must be valid
+  T& operator[](slot_handle handle) {
+    return _items[_slots[handle & SLOT_MASK].dense];
+  }
+  const T& operator[](slot_handle handle) const {
+    return _items[_slots[handle & SLOT_MASK].dense];
+  }
+
+  // dense access, in no particular order
+  size_t size() const { return _items.size(); }
+  bool empty() const { return _items.empty(); }
+  T& dense(size_t i) { return _items[i]; }
+  const T& dense(size_t i) const { return _items[i]; }
+  slot_handle handle_at(size_t i) const { return _handles[i]; }
+  iterator begin() { return _items.begin(); }
+  iterator end() { return _items.end(); }
+  const_iterator begin() const { return _items.begin(); }
+  const_iterator end() const { return _items.end(); }
+
+private:
+  enum { SLOT_MASK = (1u << SLOT_BITS) - 1 };
+  enum { GENERATIONS = 1u << (32 - SLOT_BITS) };
+
+  typedef struct {
+    uint32_t dense; // index in _items while the slot is used
+    uint32_t generation;
+  } slot_t;
+
+  static slot_t make_slot(uint32_t generation) {
+    slot_t s = {0, generation};
+    return s;
+  }
+
+  std::vector<T> _items;
+  std::vector<slot_handle> _handles; // by dense index
+  std::vector<slot_t> _slots;
+  std::vector<uint32_t> _free; // unused slots
+};
+
+#endif // SLOT_MAP_HPP
@@ -0,0 +1,82 @@
+#ifndef SPATIAL_HASH_HPP
+#define SPATIAL_HASH_HPP
+
+#include <algorithm>
+#include <vector>
+#include "slot_map.hpp"
+
+// handles bucketed by position on a uniform grid of square cells, so range
+// queries only look at the cells around them
+class spatial_hash {
+public:
+  static const int CELL_TILES = 8; // cell side
+
+  spatial_hash() : _cols(0), _rows(0) {}
+
+  // empties it for a map of w x h tiles
+  void assign(int w, int h) {
+    _cols = (w + CELL_TILES - 1) / CELL_TILES;
+    _rows = (h + CELL_TILES - 1) / CELL_TILES;
+    _cells.assign(size_t(_cols) * _rows, std::vector<slot_handle>());
+  }
+
+  void insert(slot_handle handle, int x, int y) {
+    if (_cells.empty()) {
+      return;
+    }
+    _cells[cell(x, y)].push_back(handle);
+  }
+
+  void erase(slot_handle handle, int x, int y) {
+    if (_cells.empty()) {
+      return;
+    }
+    std::vector<slot_handle>& c = _cells[cell(x, y)];
+    std::vector<slot_handle>::iterator it = std::find(c.begin(), c.end(),
+                                                      handle);
+    if (it != c.end()) {
+      *it = c.back();
+      c.pop_back();
+    }
+  }
+
+  void move(slot_handle handle, int x0, int y0, int x1, int y1) {
+    if (cell(x0, y0) != cell(x1, y1)) {
+      erase(handle, x0, y0);
+      insert(handle, x1, y1);
+    }
+  }
+
+  // adds everyone in the cells touching the square of radius r around
+  // (x, y), the caller checks the exact distance
+  void query(int x, int y, int r, std::vector<slot_handle>& found) const {
+    int cx0 = std::max(column(x - r), 0);
+    int cy0 = std::max(column(y - r), 0);
+    int cx1 = std::min(column(x + r), _cols - 1);
+    int cy1 = std::min(column(y + r), _rows - 1);
+    for (int cy = cy0; cy <= cy1; ++cy) {
+      for (int cx = cx0; cx <= cx1; ++cx) {
+        const std::vector<slot_handle>& c = _cells[size_t(cy) * _cols + cx];
+        found.insert(found.end(), c.begin(), c.end());
+      }
+    }
+  }
+
+private:
+  // floor division, so positions left or above the map are outside too
+  static int column(int x) {
+    return x >= 0 ? x / CELL_TILES : -((-x + CELL_TILES - 1) / CELL_TILES);
+  }
+  // positions outside the map go to the nearest cell
+  size_t cell(int x, int y) const {
+    int cx = std::min(std::max(column(x), 0), _cols - 1);
+    int cy = std::min(std::max(column(y), 0), _rows - 1);
+    return size_t(cy) * _cols + cx;
+  }
+
+  int _cols;
+  int _rows;
+  std::vector<std::vector<slot_handle> > _cells;
+};
+
+#endif // SPATIAL_HASH_HPP
@@ -0,0 +1,56 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// lock-free ring buffer between exactly one producer thread and one consumer
+// thread, the capacity is rounded up to a power of two
+template <class T>
+class spsc_queue {
+public:
+  explicit spsc_queue(size_t capacity) : _head(0), _tail(0) {
+    size_t size = 1;
+    while (size < capacity) {
+      size *= 2;
+    }
+    _items.resize(size);
+    _mask = size - 1;
+  }
+
+  // producer only, false if the queue is full
+  bool push(T item) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) > _mask) {
+      return false;
+    }
+    _items[tail & _mask] = std::move(item);
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer only, false if the queue is empty
+  bool pop(T& item) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = std::move(_items[head & _mask]);
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::vector<T> _items;
+  size_t _mask;
+  // padded apart so the two threads don't fight over the same cache line,
+  // new only honors alignas since C++17
+  char _padding0[64];
+  std::atomic<size_t> _head; // next item to pop
+  char _padding1[64];
+  std::atomic<size_t> _tail; // next slot to push
+};
+
+#endif // SPSC_QUEUE_HPP
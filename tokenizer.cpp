@@ -0,0 +1,114 @@
+#include "tokenizer.hpp"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+bool is_delimiter(char c) {
+  return c == ',' || c == ' ' || c == '\t' || c == '\r';
+}
+
+tokenizer::tokenizer() : _data(NULL), _size(0), _next(NULL), _line(NULL),
+                         _line_end(NULL), _pos(NULL), _line_number(0) {
+}
+
+bool tokenizer::open(const string& file) {
+  if (!_mapped.open(file)) {
+    return false;
+  }
+  open(_mapped.data(), _mapped.size(), file);
+  return true;
+}
+
+void tokenizer::open(const char* data, size_t size, const string& file) {
+  _file = file;
+  _data = data;
+  _size = size;
+  _next = _line = _line_end = _pos = _data;
+  _line_number = 0;
+}
+
+bool tokenizer::next_line() {
+  const char* end = _data + _size;
+  while (_next != NULL && _next < end) {
+    _line = _next;
+    _line_end = static_cast<const char*>(memchr(_line, '\n', end - _line));
+    if (_line_end == NULL) {
+      _line_end = end;
+    }
+    _next = _line_end + 1;
+    ++_line_number;
+    _pos = _line;
+    skip_delimiters();
+    if (_pos < _line_end && *_pos != '#') {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool tokenizer::has_field() {
+  skip_delimiters();
+  return _pos < _line_end;
+}
+
+int tokenizer::read_int() {
+  if (!has_field()) {
+    error("missing number");
+  }
+  const char* p = _pos;
+  const char* end = field_end();
+  bool negative = *p == '-';
+  if (*p == '-' || *p == '+') {
+    ++p;
+  }
+  if (p == end) {
+    error("expected a number");
+  }
+  long long value = 0;
+  for (; p < end; ++p) {
+    if (*p < '0' || *p > '9') {
+      _pos = p;
+      error("expected a digit");
+    }
+    value = value * 10 + (*p - '0');
+    if (value > INT_MAX) {
+      error("number too large");
+    }
+  }
+  _pos = end;
+  return negative ? -int(value) : int(value);
+}
+
+string tokenizer::read_string() {
+  if (!has_field()) {
+    error("missing field");
+  }
+  const char* end = field_end();
+  string s(_pos, end);
+  _pos = end;
+  return s;
+}
+
+void tokenizer::error(const char* what) const {
+  fprintf(stderr, "Error: %s:%d:%d: %s\n", _file.c_str(), _line_number,
+          int(_pos - _line) + 1, what);
+  exit(EXIT_FAILURE);
+}
+
+void tokenizer::skip_delimiters() {
+  while (_pos < _line_end && is_delimiter(*_pos)) {
+    ++_pos;
+  }
+}
+
+const char* tokenizer::field_end() const {
+  const char* p = _pos;
+  while (p < _line_end && !is_delimiter(*p)) {
+    ++p;
+  }
+  return p;
+}
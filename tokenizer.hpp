@@ -0,0 +1,52 @@
+#ifndef TOKENIZER_HPP
+#define TOKENIZER_HPP
+
+#include <cstddef>
+#include <string>
+#include "mapped_file.hpp"
+
+// reads the comma or blank separated asset files in place, the file is
+// memory mapped where possible and numbers are parsed by hand
+// anything malformed is reported with its line and column and exits
+class tokenizer {
+public:
+  tokenizer();
+
+  // false if the file can't be read
+  bool open(const std::string& file);
+  // from memory that must outlive the tokenizer, file is only for errors
+  void open(const char* data, size_t size, const std::string& file);
+
+  // moves to the next line that is not blank or a comment (# first), false
+  // at the end of the file
+  bool next_line();
+  // true if the current line has more fields
+  bool has_field();
+
+  int read_int();
+  std::string read_string();
+
+  // prints where the tokenizer is and exits
+  void error(const char* what) const;
+
+private:
+  tokenizer(const tokenizer&);
+  tokenizer& operator=(const tokenizer&);
+
+  // skips the delimiters before the next field of the line
+  void skip_delimiters();
+  // end of the field starting at _pos
+  const char* field_end() const;
+
+  std::string _file;
+  mapped_file _mapped;
+  const char* _data;
+  size_t _size;
+  const char* _next; // start of the next line
+  const char* _line; // start of the current line
+  const char* _line_end;
+  const char* _pos;
+  int _line_number;
+};
+
+#endif // TOKENIZER_HPP
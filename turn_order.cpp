@@ -0,0 +1,76 @@
+#include "turn_order.hpp"
+
+using namespace std;
+
+void turn_order::insert(slot_handle handle, int initiative) {
+  if (contains(handle)) {
+    erase(handle);
+  }
+  uint32_t slot = slot_of(handle);
+  if (slot >= _nodes.size()) {
+    node_t none = {NO_HANDLE, NO_HANDLE, NO_HANDLE, 0};
+    _nodes.resize(slot + 1, none);
+  }
+  node_t& n = node(handle);
+  n.handle = handle;
+  n.initiative = initiative;
+  ++_size;
+  if (_first == NO_HANDLE) {
+    n.prev = handle;
+    n.next = handle;
+    _first = handle;
+    _current = handle;
+    return;
+  }
+
+  // in front of the first one with a lower initiative
+  slot_handle next = _first;
+  do {
+    if (node(next).initiative < initiative) {
+      break;
+    }
+    next = node(next).next;
+  } while (next != _first);
+  if (next == _first && initiative > node(_first).initiative) {
+    _first = handle;
+  }
+  n.next = next;
+  n.prev = node(next).prev;
+  node(n.prev).next = handle;
+  node(next).prev = handle;
+}
+
+void turn_order::erase(slot_handle handle) {
+  if (!contains(handle)) {
+    return;
+  }
+  node_t& n = node(handle);
+  n.handle = NO_HANDLE;
+  if (--_size == 0) {
+    _first = NO_HANDLE;
+    _current = NO_HANDLE;
+    return;
+  }
+  node(n.prev).next = n.next;
+  node(n.next).prev = n.prev;
+  // the next one plays, which can start a new round
+  if (handle == _current) {
+    _current = n.next;
+    if (_current == _first) {
+      ++_round;
+    }
+  }
+  if (handle == _first) {
+    _first = n.next;
+  }
+}
+
+void turn_order::advance() {
+  if (_current == NO_HANDLE) {
+    return;
+  }
+  _current = node(_current).next;
+  if (_current == _first) {
+    ++_round;
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef TURN_ORDER_HPP
+#define TURN_ORDER_HPP
+
+#include <cstddef>
+#include <vector>
+#include "slot_map.hpp"
+
+// who plays when, a circular list of handles sorted by initiative with a
+// cursor on the one playing, ending a turn or removing someone is O(1)
+class turn_order {
+public:
+  turn_order() : _first(NO_HANDLE), _current(NO_HANDLE), _size(0),
+                 _round(0) {}
+
+  // after everyone with the same or higher initiative, someone joining in
+  // the middle of a round plays this round if their place is still ahead
+  void insert(slot_handle handle, int initiative);
+  void erase(slot_handle handle);
+  bool contains(slot_handle handle) const {
+    uint32_t slot = slot_of(handle);
+    return slot < _nodes.size() && _nodes[slot].handle == handle;
+  }
+
+  // the handle playing, NO_HANDLE if there is no one
+  slot_handle current() const { return _current; }
+  // moves on to the next, a new round starts back at the highest initiative
+  void advance();
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  size_t round() const { return _round; } // completed so far
+
+private:
+  typedef struct {
+    slot_handle handle; // NO_HANDLE if not in the list
+    slot_handle prev;
+    slot_handle next;
+    int initiative;
+  } node_t;
+
+  node_t& node(slot_handle handle) { return _nodes[slot_of(handle)]; }
+
+  std::vector<node_t> _nodes; // by slot of the handle
+  slot_handle _first; // highest initiative
+  slot_handle _current;
+  size_t _size;
+  size_t _round;
+};
+
+#endif // TURN_ORDER_HPP
@@ -0,0 +1,169 @@
+#include "world_map.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "map_file.hpp"
+#include "mapped_file.hpp"
+
+using namespace std;
+
+const int world_map::CHUNK_BITS;
+const int world_map::CHUNK_TILES;
+const size_t world_map::DEFAULT_MAX_CHUNKS;
+
+world_map::world_map() : _max_chunks(DEFAULT_MAX_CHUNKS) {
+  reset(0, 0, NULL);
+}
+
+// defined here, where mapped_file is complete
+world_map::~world_map() {
+}
+
+void world_map::assign(int w, int h, tile_t value) {
+  reset(w, h, NULL);
+  _tiles.assign(w, h, value, TILE_NONE);
+}
+
+void world_map::assign(const grid<tile_t>& tiles) {
+  assign(tiles.width(), tiles.height(), 0);
+  for (int y = 0; y < _h; ++y) {
+    memcpy(&_tiles(0, y), &tiles(0, y), _w);
+  }
+}
+
+bool world_map::load(const string& file, const vector<material>& materials) {
+  unique_ptr<mapped_file> f(new mapped_file);
+  if (!f->open(file)) {
+    fprintf(stderr, "Error opening file: %s\n", file.c_str());
+    return false;
+  }
+  if (is_binary_map(f->data(), f->size())) {
+    map_header_t header;
+    if (!read_map_header(file, f->data(), f->size(), materials, header)) {
+      return false;
+    }
+    if (!header.is_compressed) {
+      reset(header.width, header.height, move(f));
+      _tiles_offset = header.tiles;
+      memcpy(_remap, header.remap, sizeof(_remap));
+      return true;
+    }
+  }
+  f.reset();
+
+  grid<tile_t> tiles;
+  if (!read_map(file, materials, tiles)) {
+    return false;
+  }
+  assign(tiles);
+  return true;
+}
+
+void world_map::set(int x, int y, tile_t tile) {
+  if (!_file) {
+    _tiles(x, y) = tile;
+    return;
+  }
+  size_t c = chunk_of(x, y);
+  touch(c);
+  chunk_t& chunk = _chunks[c];
+  if (!chunk.is_kept) {
+    unlink(c);
+    chunk.is_kept = true;
+  }
+  chunk.tiles[cell_of(x, y)] = tile;
+}
+
+void world_map::set_max_chunks(size_t max_chunks) {
+  _max_chunks = max(max_chunks, size_t(1));
+  while (_loaded > _max_chunks) {
+    drop_oldest();
+  }
+}
+
+void world_map::reset(int w, int h, unique_ptr<mapped_file> file) {
+  _w = w;
+  _h = h;
+  _cols = (w + CHUNK_TILES - 1) >> CHUNK_BITS;
+  _tiles = grid<tile_t>();
+  _file = move(file);
+  _tiles_offset = 0;
+  _chunks.clear();
+  if (_file) {
+    chunk_t empty = {vector<tile_t>(), NO_CHUNK, NO_CHUNK, false};
+    _chunks.assign(size_t(_cols) * ((h + CHUNK_TILES - 1) >> CHUNK_BITS),
+                   empty);
+  }
+  _newest = NO_CHUNK;
+  _oldest = NO_CHUNK;
+  _loaded = 0;
+}
+
+void world_map::touch(size_t c) const {
+  chunk_t& chunk = _chunks[c];
+  if (chunk.tiles.empty()) {
+    if (_loaded >= _max_chunks) {
+      drop_oldest();
+    }
+    read_chunk(c);
+    link_newest(c);
+  } else if (!chunk.is_kept && _newest != c) {
+    unlink(c);
+    link_newest(c);
+  }
+}
+
+// tiles the file doesn't know become material 0, like missing text tiles
+void world_map::read_chunk(size_t c) const {
+  vector<tile_t>& tiles = _chunks[c].tiles;
+  tiles.assign(CHUNK_TILES * CHUNK_TILES, 0);
+  int x0 = (c % _cols) << CHUNK_BITS;
+  int y0 = (c / _cols) << CHUNK_BITS;
+  int w = min(CHUNK_TILES, _w - x0);
+  int h = min(CHUNK_TILES, _h - y0);
+  const uint8_t* data =
+      reinterpret_cast<const uint8_t*>(_file->data()) + _tiles_offset;
+  for (int y = 0; y < h; ++y) {
+    const uint8_t* src = data + size_t(y0 + y) * _w + x0;
+    tile_t* dst = &tiles[cell_of(0, y)];
+    for (int x = 0; x < w; ++x) {
+      tile_t tile = _remap[src[x]];
+      dst[x] = tile != TILE_NONE ? tile : 0;
+    }
+  }
+}
+
+void world_map::drop_oldest() const {
+  size_t c = _oldest;
+  unlink(c);
+  vector<tile_t>().swap(_chunks[c].tiles);
+}
+
+void world_map::link_newest(size_t c) const {
+  chunk_t& chunk = _chunks[c];
+  chunk.prev = NO_CHUNK;
+  chunk.next = _newest;
+  if (_newest != NO_CHUNK) {
+    _chunks[_newest].prev = c;
+  } else {
+    _oldest = c;
+  }
+  _newest = c;
+  ++_loaded;
+}
+
+void world_map::unlink(size_t c) const {
+  chunk_t& chunk = _chunks[c];
+  if (chunk.prev != NO_CHUNK) {
+    _chunks[chunk.prev].next = chunk.next;
+  } else {
+    _newest = chunk.next;
+  }
+  if (chunk.next != NO_CHUNK) {
+    _chunks[chunk.next].prev = chunk.prev;
+  } else {
+    _oldest = chunk.prev;
+  }
+  --_loaded;
+}
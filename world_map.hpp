@@ -0,0 +1,108 @@
+#ifndef WORLD_MAP_HPP
+#define WORLD_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "grid.hpp"
+#include "material.hpp"
+
+class mapped_file;
+
+// the tiles of the map, raw binary maps are streamed from their file in
+// square chunks: a chunk is read the first time one of its tiles is, and the
+// least recently used are dropped once more than max_chunks are loaded,
+// chunks with edited tiles are kept
+// other maps are read whole into a grid
+// reading a tile can load a chunk, so only the main thread reads the map
+class world_map {
+public:
+  static const int CHUNK_BITS = 6;
+  static const int CHUNK_TILES = 1 << CHUNK_BITS; // chunk side
+  static const size_t DEFAULT_MAX_CHUNKS = 4096; // 16 MB of tiles
+
+  world_map();
+  ~world_map();
+
+  // read whole
+  void assign(int w, int h, tile_t value);
+  void assign(const grid<tile_t>& tiles);
+  // false if the file can't be read or is not a valid map, the map is left
+  // untouched then
+  bool load(const std::string& file, const std::vector<material>& materials);
+
+  int width() const { return _w; }
+  int height() const { return _h; }
+  bool contains(int x, int y) const {
+    return x >= 0 && x < _w && y >= 0 && y < _h;
+  }
+
+  // TILE_NONE outside the map
+  tile_t operator()(int x, int y) const {
+    if (!contains(x, y)) {
+      return TILE_NONE;
+    }
+    if (!_file) {
+      return _tiles(x, y);
+    }
+    size_t c = chunk_of(x, y);
+    const chunk_t& chunk = _chunks[c];
+    if (!chunk.is_kept && c != _newest) {
+      touch(c);
+    }
+    return chunk.tiles[cell_of(x, y)];
+  }
+  // the tile must be inside the map
+  void set(int x, int y, tile_t tile);
+
+  // chunks read from the file kept in memory at once
+  void set_max_chunks(size_t max_chunks);
+  size_t loaded_chunks() const { return _loaded; }
+
+private:
+  world_map(const world_map&);
+  world_map& operator=(const world_map&);
+
+  enum { NO_CHUNK = UINT32_MAX };
+
+  typedef struct {
+    std::vector<tile_t> tiles; // empty while not loaded
+    uint32_t prev; // newer in the least recently used list
+    uint32_t next; // older
+    bool is_kept; // edited, never dropped and not in the list
+  } chunk_t;
+
+  size_t chunk_of(int x, int y) const {
+    return size_t(y >> CHUNK_BITS) * _cols + (x >> CHUNK_BITS);
+  }
+  static size_t cell_of(int x, int y) {
+    return (y & (CHUNK_TILES - 1)) << CHUNK_BITS | (x & (CHUNK_TILES - 1));
+  }
+
+  // empty, streamed from file if not NULL
+  void reset(int w, int h, std::unique_ptr<mapped_file> file);
+  // loads the chunk if needed and makes it the most recently used
+  void touch(size_t c) const;
+  void read_chunk(size_t c) const;
+  void drop_oldest() const;
+  void link_newest(size_t c) const;
+  void unlink(size_t c) const;
+
+  int _w;
+  int _h;
+  int _cols; // chunks per row
+  size_t _max_chunks;
+  grid<tile_t> _tiles; // if read whole
+  // the raw binary file the chunks are read from, if streamed
+  std::unique_ptr<mapped_file> _file;
+  size_t _tiles_offset; // in the file
+  tile_t _remap[256]; // material in the file to index in the materials
+  mutable std::vector<chunk_t> _chunks;
+  mutable uint32_t _newest;
+  mutable uint32_t _oldest;
+  mutable size_t _loaded; // chunks in the list
+};
+
+#endif // WORLD_MAP_HPP